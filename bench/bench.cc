@@ -0,0 +1,171 @@
+#include "bench.h"
+#include "kernels/cpu/gemm.h"
+#include <memory>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INFINI_BENCH_X86
+#endif
+
+namespace infini
+{
+    namespace bench
+    {
+        namespace
+        {
+            // Multiply-adds on independent accumulators, enough of them to
+            // hide the FMA latency; returns a value so that the loop is kept.
+            constexpr size_t FmaIterations = 1 << 20;
+
+            float fmaScalar()
+            {
+                float acc[16] = {};
+                for (size_t it = 0; it < FmaIterations; ++it)
+#pragma omp simd
+                    for (size_t j = 0; j < 16; ++j)
+                        acc[j] = acc[j] * 0.999f + 0.001f;
+                float sum = 0;
+                for (float v : acc)
+                    sum += v;
+                return sum;
+            }
+
+#ifdef INFINI_BENCH_X86
+            __attribute__((target("avx2,fma"))) float fmaAvx2()
+            {
+                __m256 acc[10], m = _mm256_set1_ps(0.999f),
+                                a = _mm256_set1_ps(0.001f);
+                for (auto &v : acc)
+                    v = _mm256_setzero_ps();
+                for (size_t it = 0; it < FmaIterations; ++it)
+#pragma GCC unroll 10
+                    for (auto &v : acc)
+                        v = _mm256_fmadd_ps(v, m, a);
+                float sum = 0;
+                for (auto &v : acc)
+                    sum += _mm256_cvtss_f32(v);
+                return sum;
+            }
+
+            __attribute__((target("avx512f"))) float fmaAvx512()
+            {
+                __m512 acc[10], m = _mm512_set1_ps(0.999f),
+                                a = _mm512_set1_ps(0.001f);
+                for (auto &v : acc)
+                    v = _mm512_setzero_ps();
+                for (size_t it = 0; it < FmaIterations; ++it)
+#pragma GCC unroll 10
+                    for (auto &v : acc)
+                        v = _mm512_fmadd_ps(v, m, a);
+                float sum = 0;
+                for (auto &v : acc)
+                    sum += _mm512_cvtss_f32(v);
+                return sum;
+            }
+#endif
+
+            // The widest of the probes above and its flops per call.
+            pair<float (*)(), double> fmaProbe()
+            {
+#ifdef INFINI_BENCH_X86
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx512f"))
+                    return {fmaAvx512, 2.0 * 10 * 16 * FmaIterations};
+                if (__builtin_cpu_supports("avx2") &&
+                    __builtin_cpu_supports("fma"))
+                    return {fmaAvx2, 2.0 * 10 * 8 * FmaIterations};
+#endif
+                return {fmaScalar, 2.0 * 16 * FmaIterations};
+            }
+        } // namespace
+
+        void printRooflines(std::ostream &os, const Rooflines &roofs)
+        {
+            os << "Roofline (sgemm micro kernel " << cpu::sgemmKernelName()
+               << ")\n"
+               << std::fixed << std::setprecision(1);
+            for (const auto &[threads, roof] : roofs)
+                os << std::setw(4) << threads << " threads: " << std::setw(8)
+                   << roof.gbPerSec << " GB/s " << std::setw(9)
+                   << roof.gflopsPerSec << " GFLOP/s\n";
+            os << std::defaultfloat << std::flush;
+        }
+
+        Roofline measureRoofline(const RuntimeObj &runtime)
+        {
+            const size_t threads = runtime.getNumThreads();
+
+            // Stream triad over buffers well beyond the last level cache.
+            const size_t n = size_t(1) << 24;
+            std::unique_ptr<float[]> a(new float[n]), b(new float[n]),
+                c(new float[n]);
+            std::fill_n(b.get(), n, 1.f);
+            std::fill_n(c.get(), n, 2.f);
+            auto stream = measure(
+                [&]
+                {
+                    runtime.parallelFor(
+                        n, n / threads,
+                        [&](size_t begin, size_t end)
+                        {
+                            float *pa = a.get();
+                            const float *pb = b.get(), *pc = c.get();
+#pragma omp simd
+                            for (size_t i = begin; i < end; ++i)
+                                pa[i] = pb[i] + 3.f * pc[i];
+                        });
+                });
+
+            auto [probe, flops] = fmaProbe();
+            volatile float sink = 0;
+            auto compute = measure(
+                [&, probe = probe]
+                {
+                    runtime.parallelFor(threads, 1,
+                                        [&](size_t begin, size_t end)
+                                        {
+                                            for (size_t t = begin; t < end;
+                                                 ++t)
+                                                sink = sink + probe();
+                                        });
+                });
+            return {3.0 * n * sizeof(float) / stream.front() / 1e9,
+                    flops * threads / compute.front() / 1e9};
+        }
+
+        void printResults(std::ostream &os, const string &title,
+                          const vector<Result> &results,
+                          const Rooflines &roofs)
+        {
+            if (results.empty())
+                return;
+            os << "\n" << title << "\n";
+            os << std::fixed << std::left << std::setw(16) << "Case"
+               << std::setw(34)
+               << "Config" << std::right << std::setw(4) << "Thr"
+               << std::setw(12) << "Median(us)" << std::setw(12) << "Min(us)"
+               << std::setw(10) << "GB/s" << std::setw(10) << "GFLOP/s"
+               << std::setw(8) << "%roof"
+               << "\n";
+            for (const auto &r : results)
+            {
+                double median = percentile(r.seconds, 50);
+                double gbs = r.bytes / median / 1e9;
+                double gflops = r.flops / median / 1e9;
+                const auto &roof = roofs.at(r.threads);
+                double attainable = roof.attainable(r.bytes, r.flops);
+                double share = attainable > 0 ? gflops / attainable
+                                              : gbs / roof.gbPerSec;
+                os << std::left << std::setw(16) << r.name << std::setw(34)
+                   << r.config << std::right << std::setw(4) << r.threads
+                   << std::setprecision(1) << std::setw(12) << median * 1e6
+                   << std::setw(12) << r.seconds.front() * 1e6
+                   << std::setprecision(2) << std::setw(10) << gbs
+                   << std::setw(10) << gflops << std::setprecision(1)
+                   << std::setw(8) << 100 * share << "\n";
+            }
+            os << std::defaultfloat << std::flush;
+        }
+
+    } // namespace bench
+} // namespace infini
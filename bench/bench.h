@@ -0,0 +1,199 @@
+#pragma once
+#include "core/graph.h"
+#include "core/runtime.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace infini
+{
+    namespace bench
+    {
+        using Clock = std::chrono::steady_clock;
+
+        /**
+         * @brief Seconds each case is repeated for, from INFINI_BENCH_TIME.
+         */
+        inline double minSeconds()
+        {
+            static double seconds = []
+            {
+                const char *env = std::getenv("INFINI_BENCH_TIME");
+                return env ? std::atof(env) : 0.2;
+            }();
+            return seconds;
+        }
+
+        /**
+         * @brief Thread counts to sweep: 1, then doubling up to the hardware
+         * threads.
+         */
+        inline vector<size_t> threadCounts()
+        {
+            size_t hw = std::max(1u, std::thread::hardware_concurrency());
+            vector<size_t> counts;
+            for (size_t t = 1; t < hw; t *= 2)
+                counts.emplace_back(t);
+            counts.emplace_back(hw);
+            return counts;
+        }
+
+        /**
+         * @brief Discards what is written to stdout while it lives, such as
+         * the memory plan dataMalloc() prints, to keep the tables readable.
+         */
+        class QuietStdout
+        {
+            int saved;
+
+        public:
+            QuietStdout()
+            {
+                std::cout.flush();
+                std::fflush(stdout);
+                saved = dup(STDOUT_FILENO);
+                int null = open("/dev/null", O_WRONLY);
+                dup2(null, STDOUT_FILENO);
+                close(null);
+            }
+            ~QuietStdout()
+            {
+                std::cout.flush();
+                std::fflush(stdout);
+                dup2(saved, STDOUT_FILENO);
+                close(saved);
+            }
+            QuietStdout(const QuietStdout &) = delete;
+            QuietStdout &operator=(const QuietStdout &) = delete;
+        };
+
+        /**
+         * @brief Runs fn once to warm up, then at least minSamples times and
+         * for minSeconds(), and returns the sorted durations in seconds.
+         */
+        template <typename F>
+        vector<double> measure(F &&fn, size_t minSamples = 3)
+        {
+            fn();
+            vector<double> samples;
+            auto start = Clock::now();
+            do
+            {
+                auto begin = Clock::now();
+                fn();
+                samples.emplace_back(
+                    std::chrono::duration<double>(Clock::now() - begin)
+                        .count());
+            } while (samples.size() < minSamples ||
+                     std::chrono::duration<double>(Clock::now() - start)
+                             .count() < minSeconds());
+            std::sort(samples.begin(), samples.end());
+            return samples;
+        }
+
+        inline double percentile(const vector<double> &sorted, double p)
+        {
+            size_t i = std::min(sorted.size() - 1,
+                                size_t(p / 100 * sorted.size()));
+            return sorted[i];
+        }
+
+        /**
+         * @brief Fills a tensor with small nonzero values of its dtype, so
+         * that integer divisions and casts stay defined.
+         */
+        inline void fill(const Tensor &tensor)
+        {
+            tensor->setData(
+                [](void *ptr, size_t size, DataType dtype)
+                {
+                    auto bytes = static_cast<char *>(ptr);
+                    const size_t width = dtype.getSize();
+                    for (size_t i = 0; i < size; ++i)
+                    {
+                        if (dtype == DataType::Float32)
+                        {
+                            float v = 1 + float(i % 16) / 16;
+                            std::memcpy(bytes + i * 4, &v, 4);
+                        }
+                        else if (dtype == DataType::Float16 ||
+                                 dtype == DataType::BFloat16)
+                        {
+                            // 1.0 in either format.
+                            uint16_t v =
+                                dtype == DataType::Float16 ? 0x3C00 : 0x3F80;
+                            std::memcpy(bytes + i * 2, &v, 2);
+                        }
+                        else
+                        {
+                            // Little-endian: the low bytes hold the value.
+                            uint64_t v = i % 100 + 1;
+                            std::memcpy(bytes + i * width, &v, width);
+                        }
+                    }
+                });
+        }
+
+        /**
+         * @brief Peak memory bandwidth and arithmetic throughput measured on
+         * this machine with the runtime's threads, the roof kernels are
+         * compared against.
+         */
+        struct Roofline
+        {
+            double gbPerSec;
+            double gflopsPerSec;
+
+            // Best achievable GFLOP/s at flops / bytes arithmetic intensity.
+            double attainable(double bytes, double flops) const
+            {
+                if (flops == 0)
+                    return 0;
+                return std::min(gflopsPerSec, gbPerSec * flops / bytes);
+            }
+        };
+
+        /**
+         * @brief Measures the roofline for the intra-op threads the runtime
+         * currently uses.
+         */
+        Roofline measureRoofline(const RuntimeObj &runtime);
+
+        /**
+         * @brief Rooflines by thread count.
+         */
+        using Rooflines = map<size_t, Roofline>;
+
+        void printRooflines(std::ostream &os, const Rooflines &roofs);
+
+        /**
+         * @brief One measured case: bytes and flops are per execution.
+         */
+        struct Result
+        {
+            string name;
+            string config;
+            size_t threads;
+            vector<double> seconds;
+            double bytes;
+            double flops;
+        };
+
+        /**
+         * @brief Prints results with their median time, bandwidth,
+         * throughput and the share of the roofline of their thread count
+         * they reach: of the attainable GFLOP/s for ops with arithmetic,
+         * else of the bandwidth. The bandwidth roof is the one of main
+         * memory, which cases fitting in cache may exceed.
+         */
+        void printResults(std::ostream &os, const string &title,
+                          const vector<Result> &results,
+                          const Rooflines &roofs);
+
+    } // namespace bench
+} // namespace infini
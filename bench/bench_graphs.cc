@@ -0,0 +1,273 @@
+#include "bench.h"
+#include "operators/concat.h"
+#include "operators/element_wise.h"
+#include "operators/matmul.h"
+#include "operators/transpose.h"
+#include "operators/unary.h"
+
+// End-to-end cost of whole graphs: optimize(), dataMalloc() and run()
+// latency percentiles, throughput and planned memory, for synthetic MLP,
+// transformer-block and CNN-like graphs, and the cost of switching the MLP
+// between batch sizes with reshape(). Usage: bench_graphs [substring of
+// the graphs to run]. INFINI_BENCH_TIME sets the seconds spent per step.
+
+namespace infini
+{
+    namespace
+    {
+        // Matrices are kept rank 3 with a leading batch of 1, as MatMul
+        // outputs are. Weights are constants.
+        Tensor linear(const Graph &g, const Tensor &x, int out)
+        {
+            auto w = g->addTensor({x->getDims().back(), out});
+            auto b = g->addTensor(Shape{out});
+            for (const auto &t : {w, b})
+            {
+                t->setConstant();
+                bench::fill(t);
+            }
+            auto y = g->addOp<MatmulObj>(x, w, nullptr)->getOutput();
+            return g->addOp<AddObj>(y, b, nullptr)->getOutput();
+        }
+
+        Tensor relu(const Graph &g, const Tensor &x)
+        {
+            return g->addOp<ReluObj>(x, nullptr)->getOutput();
+        }
+
+        void buildMlp(const Graph &g, int batch, int hidden, int layers)
+        {
+            auto x = g->addTensor({1, batch, hidden});
+            for (int l = 0; l < layers; ++l)
+                x = linear(g, relu(g, linear(g, x, 4 * hidden)), hidden);
+        }
+
+        // Multi-head attention with one branch per head, Clip standing in
+        // for the softmax, then a feed-forward block; both are residual.
+        void buildTransformer(const Graph &g, int seq, int dim, int heads,
+                              int blocks)
+        {
+            auto x = g->addTensor({1, seq, dim});
+            const int headDim = dim / heads;
+            for (int b = 0; b < blocks; ++b)
+            {
+                TensorVec outs;
+                for (int h = 0; h < heads; ++h)
+                {
+                    auto q = linear(g, x, headDim), k = linear(g, x, headDim),
+                         v = linear(g, x, headDim);
+                    auto kt = g->addOp<TransposeObj>(k, nullptr,
+                                                     Shape{0, 2, 1})
+                                  ->getOutput();
+                    auto s = g->addOp<MatmulObj>(q, kt, nullptr)->getOutput();
+                    auto p = g->addOp<ClipObj>(s, nullptr, 0.f, 1.f)
+                                 ->getOutput();
+                    outs.emplace_back(
+                        g->addOp<MatmulObj>(p, v, nullptr)->getOutput());
+                }
+                auto attn = g->addOp<ConcatObj>(outs, nullptr, 2)->getOutput();
+                x = g->addOp<AddObj>(x, linear(g, attn, dim), nullptr)
+                        ->getOutput();
+                auto ffn = linear(g, relu(g, linear(g, x, 4 * dim)), dim);
+                x = g->addOp<AddObj>(x, ffn, nullptr)->getOutput();
+            }
+        }
+
+        // Pointwise convolutions over {1, pixels, channels} activations,
+        // with inception-like branches joined by Concat, residual Adds and
+        // NCHW <-> NHWC layout Transposes between stages.
+        void buildCnn(const Graph &g, int pixels, int channels, int stages)
+        {
+            auto x = g->addTensor({1, pixels, channels});
+            for (int s = 0; s < stages; ++s)
+            {
+                auto a = relu(g, linear(g, x, channels / 2));
+                auto b = relu(g, linear(g, x, channels / 4));
+                b = relu(g, linear(g, b, channels / 2));
+                auto y = g->addOp<ConcatObj>(TensorVec{a, b}, nullptr, 2)
+                             ->getOutput();
+                x = relu(g, g->addOp<AddObj>(x, y, nullptr)->getOutput());
+                auto nchw = g->addOp<TransposeObj>(x, nullptr, Shape{0, 2, 1})
+                                ->getOutput();
+                x = g->addOp<TransposeObj>(relu(g, nchw), nullptr,
+                                           Shape{0, 2, 1})
+                        ->getOutput();
+            }
+        }
+
+        // Thousands of tiny blocks, each with a duplicated Relu and a
+        // Transpose pair around another Relu, so that the cost of optimize()
+        // itself dominates.
+        void buildLarge(const Graph &g, int blocks)
+        {
+            auto x = g->addTensor({1, 4, 4});
+            for (int b = 0; b < blocks; ++b)
+            {
+                auto y = g->addOp<AddObj>(relu(g, x), relu(g, x), nullptr)
+                             ->getOutput();
+                auto t = g->addOp<TransposeObj>(y, nullptr, Shape{0, 2, 1})
+                             ->getOutput();
+                x = g->addOp<TransposeObj>(relu(g, t), nullptr,
+                                           Shape{0, 2, 1})
+                        ->getOutput();
+            }
+        }
+
+        struct GraphCase
+        {
+            string name;
+            std::function<void(const Graph &)> build;
+        };
+
+        struct ThreadConfig
+        {
+            size_t interOp, intraOp;
+        };
+
+        // Seconds of each call of step on a freshly built graph.
+        template <typename Step>
+        vector<double> measureFresh(const GraphCase &c, Step &&step)
+        {
+            auto runtime = NativeCpuRuntimeObj::getInstance();
+            bench::QuietStdout quiet;
+            vector<double> samples;
+            auto start = bench::Clock::now();
+            do
+            {
+                Graph g = make_ref<GraphObj>(runtime);
+                c.build(g);
+                auto begin = bench::Clock::now();
+                step(g);
+                samples.emplace_back(std::chrono::duration<double>(
+                                         bench::Clock::now() - begin)
+                                         .count());
+            } while (samples.size() < 3 ||
+                     std::chrono::duration<double>(bench::Clock::now() -
+                                                   start)
+                             .count() < bench::minSeconds());
+            std::sort(samples.begin(), samples.end());
+            return samples;
+        }
+
+        void benchGraph(const GraphCase &c,
+                        const vector<ThreadConfig> &configs)
+        {
+            auto runtime = NativeCpuRuntimeObj::getInstance();
+            auto optimize = measureFresh(c, [](const Graph &g)
+                                         { g->optimize(); });
+            auto malloc = measureFresh(c, [](const Graph &g)
+                                       { g->dataMalloc(); });
+
+            Graph g = make_ref<GraphObj>(runtime);
+            c.build(g);
+            g->optimize();
+            {
+                bench::QuietStdout quiet;
+                g->dataMalloc();
+            }
+            for (const auto &t : g->getInputs())
+                if (!t->isConstant())
+                    bench::fill(t);
+            double flops = 0;
+            for (const auto &op : g->getOperators())
+                flops += op->getFlops();
+
+            for (const auto &config : configs)
+            {
+                runtime->setNumThreads(config.interOp, config.intraOp);
+                auto run = bench::measure([&] { runtime->run(g); }, 100);
+                double p50 = bench::percentile(run, 50);
+                std::cout << std::left << std::setw(14) << c.name
+                          << std::right << std::setw(6)
+                          << g->getOperators().size() << std::setw(4)
+                          << config.interOp << "x" << std::left
+                          << std::setw(3) << runtime->getIntraOpThreads()
+                          << std::right << std::fixed << std::setprecision(1)
+                          << std::setw(12)
+                          << bench::percentile(optimize, 50) * 1e6
+                          << std::setw(12)
+                          << bench::percentile(malloc, 50) * 1e6
+                          << std::setw(12) << p50 * 1e6 << std::setw(12)
+                          << bench::percentile(run, 99) * 1e6 << std::setw(10)
+                          << 1 / p50 << std::setprecision(2) << std::setw(10)
+                          << flops / p50 / 1e9 << std::setw(10)
+                          << g->getMemoryPeak() / 1048576.0 << std::setw(10)
+                          << g->getNaiveMemorySize() / 1048576.0
+                          << std::defaultfloat
+                          << std::endl;
+            }
+            runtime->setNumThreads(1, 0);
+        }
+
+        // Alternates the batch of an MLP between two buckets, once both
+        // plans are cached, against planning memory from scratch at every
+        // switch. Kernels compiled again by the next run are not counted.
+        void benchReshape(int hidden, int layers)
+        {
+            auto runtime = NativeCpuRuntimeObj::getInstance();
+            Graph g = make_ref<GraphObj>(runtime);
+            buildMlp(g, 64, hidden, layers);
+            g->optimize();
+            Tensor x;
+            for (const auto &t : g->getInputs())
+                if (!t->isConstant())
+                    x = t;
+            vector<double> cached, replanned;
+            {
+                bench::QuietStdout quiet;
+                g->dataMalloc();
+                const int small = GraphObj::bucketOf(20);
+                int batch = 64;
+                auto step = [&](bool replan)
+                {
+                    batch = batch == 64 ? small : 64;
+                    g->reshape({{x, {1, batch, hidden}}});
+                    if (replan)
+                        g->dataMalloc();
+                };
+                cached = bench::measure([&] { step(false); });
+                replanned = bench::measure([&] { step(true); });
+            }
+            std::cout << "mlp batch 32 <-> 64, switch: cached "
+                      << bench::percentile(cached, 50) * 1e6
+                      << " us, re-planned "
+                      << bench::percentile(replanned, 50) * 1e6 << " us"
+                      << std::endl;
+        }
+    } // namespace
+} // namespace infini
+
+int main(int argc, char **argv)
+{
+    using namespace infini;
+    string filter = argc > 1 ? argv[1] : "";
+    vector<GraphCase> cases{
+        {"mlp-small", [](const Graph &g) { buildMlp(g, 32, 256, 4); }},
+        {"mlp-large", [](const Graph &g) { buildMlp(g, 128, 512, 4); }},
+        {"transformer",
+         [](const Graph &g) { buildTransformer(g, 128, 256, 4, 2); }},
+        {"cnn", [](const Graph &g) { buildCnn(g, 56 * 56, 64, 4); }},
+        {"blocks-50k", [](const Graph &g) { buildLarge(g, 50000 / 6); }},
+    };
+
+    const size_t hw = std::max(1u, std::thread::hardware_concurrency());
+    vector<ThreadConfig> configs{{1, 1}};
+    if (hw > 1)
+        configs.push_back({1, hw});
+    if (hw > 3)
+        configs.push_back({2, hw / 2});
+
+    std::cout << std::left << std::setw(14) << "Graph" << std::right
+              << std::setw(6) << "Ops" << std::setw(8) << "Threads"
+              << std::setw(12) << "Opt(us)" << std::setw(12) << "Malloc(us)"
+              << std::setw(12) << "p50(us)" << std::setw(12) << "p99(us)"
+              << std::setw(10) << "Runs/s" << std::setw(10) << "GFLOP/s"
+              << std::setw(10) << "Peak(MB)" << std::setw(10) << "Naive(MB)"
+              << std::endl;
+    for (const auto &c : cases)
+        if (c.name.find(filter) != string::npos)
+            benchGraph(c, configs);
+    if (string("reshape").find(filter) != string::npos)
+        benchReshape(256, 4);
+    return 0;
+}
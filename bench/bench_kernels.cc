@@ -0,0 +1,280 @@
+#include "bench.h"
+#include "operators/concat.h"
+#include "operators/element_wise.h"
+#include "operators/matmul.h"
+#include "operators/transpose.h"
+#include "operators/unary.h"
+
+// Throughput of every CPU kernel over shapes, dtypes and intra-op thread
+// counts. Usage: bench_kernels [substring of the cases to run]. The time
+// spent per case is set by INFINI_BENCH_TIME (seconds, default 0.2).
+
+namespace infini
+{
+    namespace
+    {
+        string filter;
+        bench::Rooflines roofs;
+
+        string shapeToString(const Shape &shape)
+        {
+            string s;
+            for (size_t i = 0; i < shape.size(); ++i)
+                s += (i ? "x" : "") + to_string(shape[i]);
+            return s;
+        }
+
+        /**
+         * @brief Builds a graph holding the op returned by build, then times
+         * its runs for every thread count.
+         */
+        template <typename Build>
+        void runCase(vector<bench::Result> &results, const string &name,
+                     const string &config, Build &&build)
+        {
+            if ((name + " " + config).find(filter) == string::npos)
+                return;
+            auto runtime = NativeCpuRuntimeObj::getInstance();
+            Graph g = make_ref<GraphObj>(runtime);
+            Operator op = build(g);
+            {
+                bench::QuietStdout quiet;
+                g->dataMalloc();
+            }
+            double bytes = 0;
+            for (const auto &t : op->getInputs())
+            {
+                bench::fill(t);
+                bytes += t->getBytes();
+            }
+            for (const auto &t : op->getOutputs())
+                bytes += t->getBytes();
+            for (size_t threads : bench::threadCounts())
+            {
+                runtime->setNumThreads(1, threads);
+                results.push_back({name, config, threads,
+                                   bench::measure([&] { runtime->run(g); }),
+                                   bytes, double(op->getFlops())});
+            }
+            runtime->setNumThreads(1, 0);
+        }
+
+        void benchMatmul()
+        {
+            struct Case
+            {
+                Shape a, b;
+                bool transA, transB;
+            };
+            vector<pair<DataType, vector<Case>>> sweeps{
+                {DataType::Float32,
+                 {{{64, 64}, {64, 64}, false, false},
+                  {{256, 256}, {256, 256}, false, false},
+                  {{512, 512}, {512, 512}, false, false},
+                  {{1024, 1024}, {1024, 1024}, false, false},
+                  {{512, 512}, {512, 512}, true, false},
+                  {{512, 512}, {512, 512}, false, true},
+                  {{1, 4096}, {4096, 1024}, false, false},
+                  {{16, 128, 64}, {16, 64, 128}, false, false},
+                  {{16, 128, 64}, {64, 128}, false, false}}},
+                {DataType::UInt32,
+                 {{{64, 64}, {64, 64}, false, false},
+                  {{128, 128}, {128, 128}, false, false}}},
+            };
+            vector<bench::Result> results;
+            for (const auto &[dtype, cases] : sweeps)
+                for (const auto &c : cases)
+                    runCase(results, "MatMul",
+                            dtype.toString() + " " + shapeToString(c.a) +
+                                (c.transA ? "T" : "") + "*" +
+                                shapeToString(c.b) + (c.transB ? "T" : ""),
+                            [&](const Graph &g) -> Operator
+                            {
+                                return g->addOp<MatmulObj>(
+                                    g->addTensor(c.a, dtype),
+                                    g->addTensor(c.b, dtype), nullptr,
+                                    c.transA, c.transB);
+                            });
+            bench::printResults(std::cout, "MatMul", results, roofs);
+        }
+
+        template <typename T>
+        Operator addBinary(const Graph &g, const Tensor &a, const Tensor &b)
+        {
+            return g->addOp<T>(a, b, nullptr);
+        }
+
+        void benchElementWise()
+        {
+            const Shape shape{64, 64, 256};
+            vector<pair<string, pair<Shape, Shape>>> patterns{
+                {"same", {shape, shape}},
+                {"scalar", {shape, {1}}},
+                {"row", {shape, {256}}},
+                {"column", {shape, {64, 64, 1}}},
+                {"middle", {shape, {64, 1, 256}}},
+                {"outer", {{64, 64, 1}, {1, 1, 256}}},
+            };
+            vector<pair<string, Operator (*)(const Graph &, const Tensor &,
+                                             const Tensor &)>>
+                ops{{"Add", addBinary<AddObj>},
+                    {"Sub", addBinary<SubObj>},
+                    {"Mul", addBinary<MulObj>},
+                    {"Div", addBinary<DivObj>}};
+            vector<bench::Result> results;
+            for (auto dtype : {DataType::Float32, DataType::UInt32})
+                for (const auto &[opName, build] : ops)
+                    for (const auto &[pattern, shapes] : patterns)
+                    {
+                        // Every op on the plain case, Add on every pattern.
+                        if (opName != "Add" && pattern != "same")
+                            continue;
+                        runCase(results, opName,
+                                dtype.toString() + " " + pattern + " " +
+                                    shapeToString(shapes.first) + "+" +
+                                    shapeToString(shapes.second),
+                                [&, build = build](const Graph &g)
+                                {
+                                    return build(
+                                        g, g->addTensor(shapes.first, dtype),
+                                        g->addTensor(shapes.second, dtype));
+                                });
+                    }
+            bench::printResults(std::cout, "Element-wise", results, roofs);
+        }
+
+        void benchTranspose()
+        {
+            vector<pair<Shape, Shape>> cases{
+                {{1024, 1024}, {1, 0}},
+                {{64, 256, 256}, {0, 2, 1}},
+                {{64, 256, 256}, {2, 1, 0}},
+                {{64, 256, 256}, {1, 0, 2}},
+                {{16, 64, 32, 64}, {0, 2, 1, 3}},
+                {{16, 64, 32, 64}, {0, 3, 1, 2}},
+                {{16, 64, 32, 64}, {3, 2, 1, 0}},
+            };
+            vector<bench::Result> results;
+            for (auto dtype : {DataType::Float32, DataType::UInt32})
+                for (const auto &[shape, perm] : cases)
+                    runCase(results, "Transpose",
+                            dtype.toString() + " " + shapeToString(shape) +
+                                " perm " + shapeToString(perm),
+                            [&](const Graph &g) -> Operator
+                            {
+                                return g->addOp<TransposeObj>(
+                                    g->addTensor(shape, dtype), nullptr,
+                                    perm);
+                            });
+            bench::printResults(std::cout, "Transpose", results, roofs);
+        }
+
+        void benchConcat()
+        {
+            struct Case
+            {
+                Shape shape;
+                int inputs, axis;
+            };
+            vector<Case> cases{
+                {{64, 64, 256}, 3, 0},  {{64, 64, 256}, 3, 1},
+                {{64, 64, 256}, 3, 2},  {{64, 64, 16}, 16, 2},
+                {{4096, 4}, 64, 1},
+            };
+            vector<bench::Result> results;
+            for (const auto &c : cases)
+                runCase(results, "Concat",
+                        "Float32 " + to_string(c.inputs) + "x" +
+                            shapeToString(c.shape) + " axis " +
+                            to_string(c.axis),
+                        [&](const Graph &g) -> Operator
+                        {
+                            TensorVec inputs;
+                            for (int i = 0; i < c.inputs; ++i)
+                                inputs.emplace_back(g->addTensor(c.shape));
+                            return g->addOp<ConcatObj>(inputs, nullptr,
+                                                       c.axis);
+                        });
+            bench::printResults(std::cout, "Concat", results, roofs);
+        }
+
+        void benchUnary()
+        {
+            vector<bench::Result> results;
+            for (int size : {1 << 16, 1 << 20, 1 << 24})
+                for (auto dtype : {DataType::Float32, DataType::UInt32})
+                {
+                    string config =
+                        dtype.toString() + " " + to_string(size);
+                    runCase(results, "Relu", config,
+                            [&](const Graph &g) -> Operator
+                            {
+                                return g->addOp<ReluObj>(
+                                    g->addTensor({size}, dtype), nullptr);
+                            });
+                    runCase(results, "Clip", config,
+                            [&](const Graph &g) -> Operator
+                            {
+                                return g->addOp<ClipObj>(
+                                    g->addTensor({size}, dtype), nullptr,
+                                    2.f, 50.f);
+                            });
+                }
+            bench::printResults(std::cout, "Relu and Clip", results, roofs);
+        }
+
+        void benchCast()
+        {
+            vector<tuple<CastType, DataType, DataType>> casts{
+                {CastType::Float2Float16, DataType::Float32,
+                 DataType::Float16},
+                {CastType::Float162Float, DataType::Float16,
+                 DataType::Float32},
+                {CastType::Float2BFloat16, DataType::Float32,
+                 DataType::BFloat16},
+                {CastType::BFloat162Float, DataType::BFloat16,
+                 DataType::Float32},
+                {CastType::Float2Int32, DataType::Float32, DataType::Int32},
+                {CastType::Int322Float, DataType::Int32, DataType::Float32},
+                {CastType::Int642Int32, DataType::Int64, DataType::Int32},
+                {CastType::Uint82Float, DataType::UInt8, DataType::Float32},
+            };
+            vector<bench::Result> results;
+            for (int size : {1 << 16, 1 << 22})
+                for (const auto &[type, src, dst] : casts)
+                    runCase(results, "Cast",
+                            src.toString() + "->" + dst.toString() + " " +
+                                to_string(size),
+                            [&, type = type, src = src](const Graph &g)
+                                -> Operator
+                            {
+                                return g->addOp<CastObj>(
+                                    g->addTensor({size}, src), nullptr, type);
+                            });
+            bench::printResults(std::cout, "Cast", results, roofs);
+        }
+    } // namespace
+} // namespace infini
+
+int main(int argc, char **argv)
+{
+    using namespace infini;
+    if (argc > 1)
+        filter = argv[1];
+    auto runtime = NativeCpuRuntimeObj::getInstance();
+    for (size_t threads : bench::threadCounts())
+    {
+        runtime->setNumThreads(1, threads);
+        roofs[threads] = bench::measureRoofline(*runtime);
+    }
+    runtime->setNumThreads(1, 0);
+    bench::printRooflines(std::cout, roofs);
+
+    benchMatmul();
+    benchElementWise();
+    benchTranspose();
+    benchConcat();
+    benchUnary();
+    benchCast();
+    return 0;
+}
@@ -6,9 +6,19 @@
 #endif
 #include <cstddef>
 #include <map>
+#include <set>
 #include <unordered_set>
 
 namespace infini {
+// How Allocator::alloc picks among free blocks that are large enough
+enum class AllocPolicy {
+    // Lowest address first; linear scan over the free blocks
+    FirstFit,
+    // Smallest block first (lowest address on ties); O(log n) through a
+    // size-keyed index, which usually gives a tighter peak
+    BestFit,
+};
+
 class Allocator {
   private:
     Runtime runtime;
@@ -22,6 +32,13 @@ class Allocator {
     // pointer to the memory actually allocated
     void *ptr;
 
+    // bytes at ptr, the largest peak bound so far
+    size_t capacity;
+
+    // whether getPtr() was called since the plan began; the plan is then
+    // frozen until reset()
+    bool bound;
+
     // =================================== 作业
     // ===================================
     // TODO：可能需要设计一个数据结构来存储free block，以便于管理和合并
@@ -30,10 +47,16 @@ class Allocator {
     // =================================== 作业
     // ===================================
 
+    // free blocks keyed by address, used for coalescing neighbours
     std::map<size_t, size_t> free_blocks;
 
+    // the same free blocks as (size, address), used by best-fit lookup
+    std::set<std::pair<size_t, size_t>> free_blocks_by_size;
+
+    AllocPolicy policy;
+
   public:
-    Allocator(Runtime runtime);
+    Allocator(Runtime runtime, AllocPolicy policy = AllocPolicy::FirstFit);
 
     virtual ~Allocator();
 
@@ -51,13 +74,31 @@ class Allocator {
 
     // function: perform actual memory allocation
     // return: pointer to the head address of the allocated memory
+    // the memory is kept across reset() and only grows, so that it ends
+    // up as large as the largest plan
     void *getPtr();
 
+    // function: start a new plan, keeping the memory already allocated
+    void reset();
+
     void info();
 
+    // Bytes currently allocated by the plan
+    size_t getUsed() const { return used; }
+
+    // High-water mark of the plan, i.e. the size getPtr() will allocate
+    size_t getPeak() const { return peak; }
+
+    // Bytes actually allocated
+    size_t getCapacity() const { return capacity; }
+
   private:
     // function: memory alignment, rouned up
     // return: size of the aligned memory block
     size_t getAlignedSize(size_t size);
+
+    // keep both free block indexes in sync
+    void insertFreeBlock(size_t addr, size_t size);
+    void eraseFreeBlock(std::map<size_t, size_t>::iterator it);
 };
 } // namespace infini
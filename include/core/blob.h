@@ -11,12 +11,18 @@ class BlobObj
 {
   Runtime runtime;
   void *ptr;
+  // Whether ptr was allocated for this blob and is freed with it.
+  bool owned = false;
 
 public:
   BlobObj(Runtime runtime, void *ptr) : runtime(runtime), ptr(ptr) {}
+  /**
+   * @brief Allocates bytes from the runtime for this blob only.
+   */
+  BlobObj(Runtime runtime, size_t bytes);
   BlobObj(BlobObj &other) = delete;
   BlobObj &operator=(BlobObj const &) = delete;
-  ~BlobObj() {};
+  ~BlobObj();
 
   template <typename T>
   T getPtr() const { return reinterpret_cast<T>(ptr); }
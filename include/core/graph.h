@@ -1,12 +1,37 @@
 #pragma once
 #include "core/allocator.h"
 #include "core/operator.h"
+#include "core/pass_manager.h"
 #include "core/tensor.h"
 #include <algorithm>
 #include <cstdint>
 
 namespace infini
 {
+    class TransposeObj;
+
+    /**
+     * @brief Ordering constraints between the operators of a sorted graph,
+     * by position in GraphObj::getOperators(). The successors of op i are
+     * successors[successorOffsets[i], successorOffsets[i + 1]) and op i has
+     * numPredecessors[i] predecessors. Edges always point forward.
+     */
+    struct OpDependencies
+    {
+        vector<size_t> numPredecessors;
+        vector<size_t> successorOffsets;
+        vector<size_t> successors;
+    };
+
+    /**
+     * @brief Kernels of the operators of a graph compiled by a runtime, in
+     * the order of GraphObj::getOperators().
+     */
+    struct ExecutionPlan
+    {
+        const RuntimeObj *runtime = nullptr;
+        vector<CompiledKernel> steps;
+    };
 
     class GraphObj : public Object
     {
@@ -14,34 +39,41 @@ namespace infini
         Runtime runtime;
         TensorVec tensors;
         OpVec ops;
+        // Marked by setOutputs(), empty if never called.
+        TensorVec outputs;
         Allocator allocator;
 
     public:
         explicit GraphObj(Runtime runtime)
-            : runtime(runtime), allocator(runtime), sorted(false){};
+            : runtime(runtime), allocator(runtime, AllocPolicy::BestFit),
+              sorted(false){};
         string toString() const override;
         Runtime getRuntime() const { return runtime; }
 
         Tensor addTensor(Shape dim, DataType dtype = DataType::Float32);
         Tensor addTensor(const Tensor &tensor);
         TensorVec addTensor(const TensorVec &tensors);
+        /**
+         * @brief Removes op or tensor from the lists, keeping the order of
+         * the others. Each call is linear in the size of the graph; rewrites
+         * use eraseOperator() and eraseTensor() instead.
+         */
         void removeOperator(Operator op)
         {
-            auto it = std::find(ops.begin(), ops.end(), op);
-            if (it != ops.end())
-                ops.erase(it);
+            eraseOperator(op);
+            compact();
         }
-
         void removeTensor(Tensor tensor)
         {
-            auto it = std::find(tensors.begin(), tensors.end(), tensor);
-            if (it != tensors.end())
-                tensors.erase(it);
+            eraseTensor(tensor);
+            compact();
         }
 
         const TensorVec &getTensors() const { return tensors; }
         const OpVec &getOperators() const { return ops; }
-        Tensor getTensor(int) const;
+        Tensor getTensor(int fuid) const;
+        bool hasOperator(const Operator &op) const;
+        bool hasTensor(const Tensor &tensor) const;
 
         /**
          * @brief Sort the nodes in topological order.
@@ -51,12 +83,108 @@ namespace infini
          */
         bool topo_sort();
 
+        /**
+         * @brief Wavefronts found by the last successful topo_sort(): level i
+         * is ops[offsets[i], offsets[i + 1]), and every input of those ops is
+         * produced by a lower level, so ops of one level are independent.
+         * Only valid while the graph stays sorted.
+         */
+        const vector<size_t> &getLevelOffsets() const
+        {
+            IT_ASSERT(sorted, "Graph is not topologically sorted");
+            return levelOffsets;
+        }
+
+        /**
+         * @brief Simplifies the graph with a fixed sequence of passes, whose
+         * statistics are then available from getPassStats().
+         */
         void optimize();
+        const vector<PassStats> &getPassStats() const { return passStats; }
+
+        /**
+         * @brief Replaces subgraphs matching the pattern of a rule, rooted at
+         * any op, until no rule matches; the rules are tried in order. Ops
+         * around a replacement are revisited, so that matches it completes
+         * are found. Returns the number of matches replaced per rule.
+         */
+        vector<size_t> applyRewrites(const vector<RewriteRule> &rules);
+
+        /**
+         * @brief Sets the shape of tensor, typically a graph input, and
+         * marks it for the next shape_infer().
+         */
+        void setShape(const Tensor &tensor, const Shape &dims);
 
+        /**
+         * @brief Propagates shapes through the graph. If tensors were marked
+         * by setShape(), only the operators downstream of them whose input
+         * shapes changed are re-inferred, in topological order; otherwise
+         * every operator is. Results are memoized per operator by input
+         * shapes and attributes, so switching back to a shape seen before
+         * does not call inferShape() again.
+         */
         void shape_infer();
 
+        /**
+         * @brief Dependencies between the sorted operators: data dependencies
+         * from topo_sort(), plus the ones dataMalloc() adds so that memory is
+         * only reused or overwritten in place once every earlier reader is
+         * done. Running each op once its predecessors have finished is thus
+         * equivalent to running ops in order.
+         */
+        const OpDependencies &getDependencies() const
+        {
+            IT_ASSERT(sorted, "Graph is not topologically sorted");
+            return dependencies;
+        }
+
+        /**
+         * @brief Plans memory for all tensors from their lifetimes in
+         * topological order and binds them to a single buffer. Intermediates
+         * whose lifetimes do not overlap share memory, operators that support
+         * it write in place into an input consumed last by them, and inputs
+         * of a Concat over its outermost non-unit dim are produced directly
+         * inside its output.
+         */
         void dataMalloc();
 
+        /**
+         * @brief Re-plans the graph for inputs of new shapes, such as another
+         * batch size: shapes are inferred again from the changed inputs, and
+         * tensors are bound to the memory and execution plans cached for the
+         * resulting input shapes, or to new ones from dataMalloc(). Plans are
+         * cached per set of input shapes, so dynamic dims should be rounded
+         * up to a few buckets, see bucketOf(). All plans share one buffer,
+         * grown to the largest of them.
+         */
+        void reshape(const vector<pair<Tensor, Shape>> &inputShapes);
+
+        /**
+         * @brief The bucket of a dynamic dim of size n: the next power of
+         * two.
+         */
+        static int bucketOf(int n);
+
+        /**
+         * @brief Plan cached by the runtime across runs. It is dropped when
+         * ops, their order, shapes or the memory plan change; call
+         * invalidatePlan() after rebinding tensor data by other means.
+         */
+        ExecutionPlan &getPlan() { return plan; }
+        void invalidatePlan() { plan = {}; }
+
+        /**
+         * @brief Bytes of the buffer planned by dataMalloc().
+         */
+        size_t getMemoryPeak() const { return memoryPeak; }
+
+        /**
+         * @brief Bytes the non-constant tensors of the plan would take
+         * without any sharing, to compare getMemoryPeak() with.
+         */
+        size_t getNaiveMemorySize() const { return memoryNaive; }
+
         /**
          * @brief Add an operator and create its outputs. Output tensor arguments
          * should be empty Refs (e.g., nullptr).
@@ -93,10 +221,13 @@ namespace infini
         }
 
         /**
-         * @brief Gets output tensors of this graph.
+         * @brief Gets output tensors of this graph: those marked with
+         * setOutputs(), or else every tensor no operator reads.
          */
         inline TensorVec getOutputs() const
         {
+            if (!outputs.empty())
+                return outputs;
             TensorVec ret;
             for (const auto &t : tensors)
                 if (t->getTargets().empty())
@@ -104,6 +235,13 @@ namespace infini
             return ret;
         }
 
+        /**
+         * @brief Marks the results of the graph. optimize() removes operators
+         * none of them depends on, and dataMalloc() keeps them intact even
+         * when other operators read them.
+         */
+        void setOutputs(const TensorVec &outputs);
+
         bool checkValid() const;
 
     private:
@@ -112,10 +250,175 @@ namespace infini
          */
         void addOperatorAndConnect(const Operator &op);
 
+        /**
+         * @brief Evaluates once every op whose inputs are all constants and
+         * replaces it by its outputs, which become constants. Constant
+         * inputs left unused are removed. Returns the number of ops folded.
+         */
+        size_t foldConstants();
+
+        /**
+         * @brief Whether t was marked with setOutputs(). Rewrites must keep
+         * such tensors even when they have readers.
+         */
+        bool isMarkedOutput(const Tensor &t) const
+        {
+            return std::find(outputs.begin(), outputs.end(), t) !=
+                   outputs.end();
+        }
+
+        /**
+         * @brief Merges operators equivalent to an earlier one, reading the
+         * same tensors: their readers read the outputs of the earlier one
+         * instead. Returns the number of ops merged.
+         */
+        size_t eliminateCommonSubexpressions();
+
+        /**
+         * @brief Removes operators no output of the graph depends on, and
+         * the tensors they leave without producer nor reader, graph inputs
+         * included. Returns the number of ops removed.
+         */
+        size_t removeDeadOperators();
+
+        /**
+         * @brief Disconnects op from its tensors and neighbours and removes
+         * it. Its outputs stay in the graph without a source.
+         */
+        void detachOperator(const Operator &op);
+
+        /**
+         * @brief Makes every reader of from read to instead.
+         */
+        void replaceAllUses(const Tensor &from, const Tensor &to);
+
+        /**
+         * @brief Rewrites Transposes until none applies: identities are
+         * removed, chains are composed into one permutation, Transposes
+         * swapping the last two dims fold into the MatMuls reading them, and
+         * Transposes are moved below element-wise ops when that lets them
+         * merge with a later Transpose or MatMul. A Transpose read by other
+         * ops too is kept for them. Returns the number of rewrites.
+         */
+        size_t simplifyTransposes();
+        bool simplifyTranspose(const Ref<TransposeObj> &transpose);
+
+        /**
+         * @brief For op reading the output of transpose: its other operand
+         * (that output itself for unary ops) when the Transpose commutes
+         * with op, null otherwise.
+         */
+        Tensor sinkInputOf(const Ref<TransposeObj> &transpose,
+                           const Operator &op) const;
+        bool canSink(const Ref<TransposeObj> &transpose) const;
+
+        /**
+         * @brief Replaces the ops of match, as found by Pattern::match(), by
+         * replacement, which produces the outputs of the root of match.
+         */
+        void replaceMatch(const OpVec &match, const OpVec &replacement);
+
+        /**
+         * @brief Replaces every chain of element-wise ops whose intermediates
+         * have a single consumer with one FusedElementWiseObj, so that the
+         * intermediates are never materialized. Returns the number of fused
+         * ops created.
+         */
+        size_t fuseElementWise();
+
+        /**
+         * @brief Removal in constant time: the slot of op or tensor is left
+         * null until compact() closes the holes, which every public method
+         * and every pass of optimize() does before returning.
+         */
+        void eraseOperator(const Operator &op);
+        void eraseTensor(const Tensor &tensor);
+        void compact();
+
+        /**
+         * @brief Output shapes of op for its current inputs, from the memo
+         * of op when they were inferred before.
+         */
+        vector<Shape> inferShapeOf(const Operator &op);
+
         /**
          * @brief If the nodes is sorted in topological order.
          */
         bool sorted;
+
+        /**
+         * @brief Slot in ops by guid and in tensors by fuid, and the number
+         * of null slots.
+         */
+        std::unordered_map<UidBaseType, size_t> opSlots, tensorSlots;
+        size_t holes = 0;
+
+        /**
+         * @brief Level boundaries in ops, see getLevelOffsets().
+         */
+        vector<size_t> levelOffsets;
+
+        /**
+         * @brief Producer -> consumer edges found by topo_sort(), and those
+         * plus the memory ordering edges of dataMalloc().
+         */
+        vector<pair<size_t, size_t>> dataEdges;
+        OpDependencies dependencies;
+
+        ExecutionPlan plan;
+
+        /**
+         * @brief A memory plan made by dataMalloc() and the execution plan
+         * compiled for it, with the graph they were made for: its input
+         * shapes and the uids of its ops, non-constant tensors and marked
+         * outputs. Offsets are those of the non-constant tensors, in order.
+         */
+        struct MemoryPlan
+        {
+            vector<Shape> inputShapes;
+            vector<UidBaseType> opGuids, tensorFuids, outputFuids;
+            vector<size_t> offsets;
+            vector<int> inplaceInputs;
+            OpDependencies dependencies;
+            size_t peak = 0, naive = 0;
+            ExecutionPlan plan;
+        };
+        static constexpr size_t maxMemoryPlans = 8;
+        vector<MemoryPlan> memoryPlans;
+        // Index of the plan tensors are bound to, or memoryPlans.size().
+        size_t currentPlan = 0;
+        size_t memoryPeak = 0, memoryNaive = 0;
+
+        /**
+         * @brief A plan holding only the description of the graph as it is.
+         */
+        MemoryPlan describePlan() const;
+        static bool samePlan(const MemoryPlan &a, const MemoryPlan &b);
+
+        /**
+         * @brief Keeps the execution plan with the memory plan it was
+         * compiled for, before tensors are bound to another one.
+         */
+        void stashPlan();
+        void bindPlan(size_t index);
+
+        /**
+         * @brief Tensors marked by setShape() since the last shape_infer(),
+         * and output shapes inferred per op guid by input shapes. A memo is
+         * cleared when the attributes of its op change, or when it holds
+         * maxShapeMemo entries.
+         */
+        TensorVec shapeChanged;
+        struct ShapeMemo
+        {
+            vector<int> attrs;
+            std::map<vector<Shape>, vector<Shape>> outputs;
+        };
+        std::unordered_map<UidBaseType, ShapeMemo> shapeMemo;
+        static constexpr size_t maxShapeMemo = 16;
+
+        // Statistics of the passes of the last optimize().
+        vector<PassStats> passStats;
     };
 
 } // namespace infini
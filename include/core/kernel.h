@@ -21,6 +21,17 @@ namespace infini
          */
         virtual void compute(const Operator &op,
                              const RuntimeObj *context) const = 0;
+
+        /**
+         * @brief Prepares an op for repeated execution. The result is valid
+         * until the shapes or data buffers of its tensors change. By default
+         * it calls compute() each time.
+         */
+        virtual CompiledKernel compile(const Operator &op,
+                                       const RuntimeObj *context) const
+        {
+            return [this, op, context] { compute(op, context); };
+        }
     };
 
     class KernelRegistry
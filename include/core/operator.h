@@ -2,6 +2,7 @@
 
 #include "core/op_type.h"
 #include "core/tensor.h"
+#include <cstring>
 
 namespace infini
 {
@@ -18,6 +19,9 @@ namespace infini
         TensorVec outputs;
         vector<WRef<OperatorObj>> predecessors;
         vector<WRef<OperatorObj>> successors;
+        // Index of the input whose buffer the output reuses, set by memory
+        // planning; -1 if the output has its own buffer.
+        int inplaceInput = -1;
 
     public:
         OperatorObj(OpType opType, TensorVec inputs, TensorVec outputs);
@@ -55,6 +59,39 @@ namespace infini
         virtual int numInputs() const = 0;
         virtual int numOutputs() const = 0;
 
+        /**
+         * @brief Whether the kernel of this operator stays correct when its
+         * output aliases an input of the same shape, i.e. it reads each
+         * element of that input only to produce the same output element.
+         */
+        virtual bool supportsInplace() const { return false; }
+        int getInplaceInput() const { return inplaceInput; }
+
+        /**
+         * @brief Arithmetic operations of one execution, used to report
+         * achieved throughput. Data movement operators count none.
+         */
+        virtual size_t getFlops() const { return 0; }
+
+        /**
+         * @brief Attributes that, together with the type and the inputs,
+         * determine what the operator computes, e.g. the permutation of a
+         * Transpose. Floats are stored by their bits, see attrOf().
+         */
+        virtual vector<int> getOpAttrVector() const = 0;
+
+        /**
+         * @brief Hash of the type, attributes and input tensors, equal for
+         * equivalent operators.
+         */
+        size_t hash() const;
+
+        /**
+         * @brief Whether other computes the same outputs from the same
+         * tensors: same type, attributes, inputs and output data types.
+         */
+        bool isEquivalent(const OperatorObj &other) const;
+
         /**
          * @brief Clone this operator and replace its inputs and outputs.
          *
@@ -68,6 +105,12 @@ namespace infini
     protected:
         optional<vector<Shape>> inferShape();
         vector<DataType> inferDataType() const;
+        static int attrOf(float value)
+        {
+            int bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
 
     private:
         void addPredecessors(const Operator &op) { predecessors.emplace_back(op); }
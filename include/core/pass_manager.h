@@ -0,0 +1,64 @@
+#pragma once
+#include "core/rewrite.h"
+
+namespace infini
+{
+    /**
+     * @brief What one run of a pass did to a graph.
+     */
+    struct PassStats
+    {
+        string name;
+        // Rewrites applied, in the unit of the pass: ops folded, merged,
+        // removed or fused, or matches replaced.
+        size_t rewrites = 0;
+        size_t opsBefore = 0, opsAfter = 0;
+        double seconds = 0;
+        // Matches replaced per rule, for passes of rewrite rules.
+        vector<pair<string, size_t>> rules;
+    };
+
+    /**
+     * @brief Runs a sequence of graph passes once each, in order, and
+     * records their statistics.
+     */
+    class PassManager
+    {
+    public:
+        // Returns the number of rewrites it applied. The ops of the graph are
+        // counted around it, so it must not leave removed ops behind.
+        using Pass = std::function<size_t(GraphObj &)>;
+
+        void addPass(string name, Pass pass);
+
+        /**
+         * @brief Adds a pass applying rules until none matches, see
+         * GraphObj::applyRewrites().
+         */
+        void addRewrites(string name, vector<RewriteRule> rules);
+
+        /**
+         * @brief Runs every pass on graph. Returns the statistics of this
+         * run, one entry per pass.
+         */
+        const vector<PassStats> &run(GraphObj &graph);
+
+        const vector<PassStats> &getStats() const { return stats; }
+
+        /**
+         * @brief Table of the statistics of the last run.
+         */
+        static string report(const vector<PassStats> &stats);
+
+    private:
+        struct Entry
+        {
+            string name;
+            Pass pass;
+            vector<RewriteRule> rules;
+        };
+        vector<Entry> passes;
+        vector<PassStats> stats;
+    };
+
+} // namespace infini
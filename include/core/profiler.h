@@ -0,0 +1,102 @@
+#pragma once
+#include "core/operator.h"
+#include <chrono>
+#include <thread>
+
+namespace infini
+{
+    /**
+     * @brief When and on which thread one operator of a run executed.
+     */
+    struct OpSpan
+    {
+        std::chrono::steady_clock::time_point begin, end;
+        std::thread::id thread;
+    };
+
+    /**
+     * @brief Collects operator timings of the runs of a runtime and
+     * aggregates them per operator and per OpType, across runs.
+     */
+    class Profiler
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /**
+         * @brief Totals of an operator, or of every operator of an OpType.
+         * bytes and flops are per call.
+         */
+        struct Record
+        {
+            string name;
+            OpType type = OpType::Unknown;
+            string kernel;
+            size_t bytes = 0;
+            size_t flops = 0;
+            size_t calls = 0;
+            double totalUs = 0;
+            double minUs = 0;
+            double maxUs = 0;
+
+            double avgUs() const { return calls ? totalUs / calls : 0; }
+            double gbPerSec() const;
+            double gflopsPerSec() const;
+        };
+
+        Profiler() : origin(Clock::now()) {}
+
+        /**
+         * @brief Adds a run of ops, where ops[i] took spans[i].
+         */
+        void addRun(Device device, const OpVec &ops,
+                    const vector<OpSpan> &spans);
+
+        /**
+         * @brief Drops everything recorded so far.
+         */
+        void clear();
+
+        size_t getNumRuns() const { return runs; }
+
+        /**
+         * @brief Per operator records, by decreasing total time.
+         */
+        vector<Record> getOpRecords() const;
+
+        /**
+         * @brief Per OpType records, by decreasing total time.
+         */
+        vector<Record> getTypeRecords() const;
+
+        /**
+         * @brief Tables of the OpType and operator records with their share
+         * of the total time and their achieved bandwidth and throughput.
+         */
+        string report() const;
+
+        /**
+         * @brief Writes every recorded operator execution as a Chrome trace
+         * event file, to be opened in chrome://tracing or Perfetto.
+         */
+        void dumpTrace(const string &path) const;
+
+    private:
+        struct Event
+        {
+            size_t record;
+            double beginUs, durationUs;
+            size_t thread;
+        };
+
+        Clock::time_point origin;
+        size_t runs = 0;
+        vector<Record> records;
+        // Op guid -> index in records.
+        unordered_map<UidBaseType, size_t> recordIndex;
+        vector<Event> events;
+        // Small ids for the threads that ran ops, as trace tids.
+        unordered_map<std::thread::id, size_t> threadIds;
+    };
+
+} // namespace infini
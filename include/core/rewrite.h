@@ -0,0 +1,113 @@
+#pragma once
+#include "core/operator.h"
+
+namespace infini
+{
+    /**
+     * @brief Matches an operator by type and an optional predicate, and the
+     * producers of its inputs by sub-patterns. A producer is only matched
+     * when the matched op is the sole reader of its outputs and none of them
+     * is a marked graph output, so that the whole match can be replaced.
+     */
+    class Pattern
+    {
+    public:
+        explicit Pattern(OpType type) : type(type) {}
+
+        /**
+         * @brief Restricts the op to those for which predicate holds.
+         */
+        Pattern &where(std::function<bool(const Operator &)> predicate)
+        {
+            this->predicate = std::move(predicate);
+            return *this;
+        }
+
+        /**
+         * @brief Requires the producer of input index of the op to match
+         * producer. For -1, the first input whose producer matches is
+         * taken.
+         */
+        Pattern &input(Pattern producer, int index = -1)
+        {
+            producer.index = index;
+            inputs.emplace_back(std::move(producer));
+            return *this;
+        }
+
+        OpType getType() const { return type; }
+
+        /**
+         * @brief Number of ops on the longest root-to-leaf path.
+         */
+        int depth() const;
+
+        /**
+         * @brief Matches op as the root and appends the matched ops to
+         * match, in pre-order with the root first. isOutput tells marked
+         * graph outputs apart. On failure, match is left as it was.
+         */
+        bool match(const Operator &op,
+                   const std::function<bool(const Tensor &)> &isOutput,
+                   OpVec &match) const;
+
+    private:
+        OpType type;
+        std::function<bool(const Operator &)> predicate;
+        vector<Pattern> inputs;
+        int index = -1;
+    };
+
+    /**
+     * @brief Creates the ops that replace a match. They may read the tensors
+     * the match reads, and new tensors made with addTensor(), and must
+     * produce every output of the root of the match.
+     */
+    class Rewriter
+    {
+    public:
+        explicit Rewriter(GraphObj &graph) : graph(graph) {}
+
+        Tensor addTensor(Shape dims, DataType dtype);
+
+        /**
+         * @brief Creates an op with all its outputs given.
+         */
+        template <typename T, typename... Args>
+        Ref<T> addOp(Args &&...args)
+        {
+            auto op = make_ref<T>(nullptr, std::forward<Args>(args)...);
+            ops.emplace_back(op);
+            return op;
+        }
+
+        /**
+         * @brief Creates a copy of op with other inputs and outputs.
+         */
+        Operator clone(const Operator &op, const TensorVec &inputs,
+                       const TensorVec &outputs);
+
+        const OpVec &getOps() const { return ops; }
+        const TensorVec &getTensors() const { return tensors; }
+
+    private:
+        GraphObj &graph;
+        OpVec ops;
+        TensorVec tensors;
+    };
+
+    /**
+     * @brief A rewrite of the subgraphs matching pattern. apply gets the ops
+     * of a match, in the order of Pattern::match(), and creates their
+     * replacement through the Rewriter, or returns false to leave the match
+     * alone. Every application must make the graph strictly simpler, so
+     * that rewriting terminates.
+     */
+    struct RewriteRule
+    {
+        string name;
+        Pattern pattern;
+        std::function<bool(Rewriter &, const OpVec &)> apply;
+    };
+
+} // namespace infini
@@ -2,6 +2,8 @@
 #include "core/common.h"
 #include "core/op_type.h"
 #include "core/ref.h"
+#include <functional>
+#include <memory>
 
 namespace infini
 {
@@ -10,6 +12,9 @@ namespace infini
   class GraphObj;
   class RuntimeObj;
   class BlobObj;
+  class ThreadPool;
+  class Profiler;
+  struct OpSpan;
 
   using Tensor = Ref<TensorObj>;
   using Operator = Ref<OperatorObj>;
@@ -20,6 +25,13 @@ namespace infini
   using TensorVec = vector<Tensor>;
   using OpVec = vector<Operator>;
 
+  /**
+   * @brief A kernel bound to one op, with everything that only depends on
+   * the op and the memory plan (dtype specialization, data pointers,
+   * strides) resolved, so that calling it only does the math.
+   */
+  using CompiledKernel = std::function<void()>;
+
   enum class Device
   {
     CPU = 1
@@ -45,14 +57,41 @@ namespace infini
     {
       return true;
     }
+    Device getDevice() const { return device; }
 
     virtual string toString() const = 0;
+
+    /**
+     * @brief Threads a kernel may use.
+     */
+    virtual size_t getNumThreads() const { return 1; }
+
+    /**
+     * @brief Calls body(begin, end) on disjoint ranges covering [0, n), each
+     * at least grain long unless n is smaller, in parallel when the runtime
+     * has threads to spare. Kernels use this instead of their own threads.
+     * The first exception thrown by body is rethrown once all ranges are done.
+     */
+    virtual void parallelFor(
+        size_t n, size_t grain,
+        const std::function<void(size_t, size_t)> &body) const
+    {
+      if (n > 0)
+        body(0, n);
+    }
   };
 
   class NativeCpuRuntimeObj : public RuntimeObj
   {
+    size_t interOpThreads = 1, intraOpThreads = 1;
+    // Shared by the scheduler and the kernels.
+    std::unique_ptr<ThreadPool> pool;
+    bool profiling = false;
+    std::unique_ptr<Profiler> profiler;
+
   public:
-    NativeCpuRuntimeObj() : RuntimeObj(Device::CPU) {}
+    NativeCpuRuntimeObj();
+    ~NativeCpuRuntimeObj();
 
     static Ref<NativeCpuRuntimeObj> &getInstance()
     {
@@ -64,6 +103,47 @@ namespace infini
     void run(const Graph &graph) const override;
     void *alloc(size_t size) override;
     string toString() const override;
+
+    /**
+     * @brief Splits the CPU threads used by run() into a pool of interOp *
+     * intraOp pinned threads: up to interOp independent operators run
+     * concurrently, following the dependencies of the graph, and kernels
+     * split their loops for intraOp threads (0 shares the hardware threads
+     * between the interOp operators). With interOp = 1 operators run one by
+     * one in graph order. By default, a single operator uses every hardware
+     * thread at a time. Must not be called while run() is in progress.
+     */
+    void setNumThreads(size_t interOp, size_t intraOp = 0);
+    size_t getInterOpThreads() const { return interOpThreads; }
+    size_t getIntraOpThreads() const { return intraOpThreads; }
+    ThreadPool &getThreadPool() const { return *pool; }
+
+    /**
+     * @brief When enabled, run() times every operator and adds the timings
+     * to getProfiler(), which keeps them until cleared.
+     */
+    void setProfiling(bool enable);
+    bool isProfiling() const { return profiling; }
+    Profiler &getProfiler() const
+    {
+      IT_ASSERT(profiler, "Profiling was never enabled");
+      return *profiler;
+    }
+
+    size_t getNumThreads() const override { return intraOpThreads; }
+    void parallelFor(
+        size_t n, size_t grain,
+        const std::function<void(size_t, size_t)> &body) const override;
+
+  private:
+    // Kernels of the graph compiled for its current memory plan, reused
+    // across runs until the graph invalidates them.
+    const vector<CompiledKernel> &compile(const Graph &graph) const;
+    // Record the span of step i in timings[i] unless timings is null.
+    void runSerial(const vector<CompiledKernel> &steps,
+                   OpSpan *timings) const;
+    void runParallel(const Graph &graph, const vector<CompiledKernel> &steps,
+                     OpSpan *timings) const;
   };
 
 } // namespace infini
@@ -24,6 +24,9 @@ namespace infini
         WRef<OperatorObj> source;
         Blob data;
         Runtime runtime;
+        bool constant = false;
+        // Layouts of constant data prepared by kernels, by layout name.
+        std::map<string, Blob> packedData;
 
     private:
         Shape shape;
@@ -49,6 +52,33 @@ namespace infini
 
         void setDataBlob(const Blob &blob);
 
+        /**
+         * @brief Marks a tensor with no source, such as a weight, as a
+         * constant and gives it storage of its own, outside of the memory
+         * planned by GraphObj::dataMalloc(), so that its data can be set
+         * right away. Data must be set before GraphObj::optimize(), which
+         * evaluates ops computed only from constants, and must not change
+         * once kernels are compiled as they may prepare it ahead of time.
+         */
+        void setConstant();
+        bool isConstant() const { return constant; }
+
+        /**
+         * @brief Copy of the data of a constant prepared once by a kernel in
+         * the layout it consumes, e.g. the panels of a GEMM operand, under a
+         * name identifying that layout; null until set.
+         */
+        Blob getPackedData(const string &layout) const
+        {
+            auto it = packedData.find(layout);
+            return it == packedData.end() ? nullptr : it->second;
+        }
+        void setPackedData(const string &layout, const Blob &blob)
+        {
+            IT_ASSERT(constant);
+            packedData[layout] = blob;
+        }
+
         void printData() const;
         bool equalData(const Tensor &rhs, double relativeError = 1e-6) const;
 
@@ -0,0 +1,109 @@
+#pragma once
+#include "core/common.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace infini
+{
+    class ThreadPool;
+
+    /**
+     * @brief Tasks spawned on a pool and waited for together.
+     */
+    class TaskGroup
+    {
+    public:
+        explicit TaskGroup(ThreadPool &pool) : pool(pool) {}
+        TaskGroup(const TaskGroup &) = delete;
+        TaskGroup &operator=(const TaskGroup &) = delete;
+        // Waits for unfinished tasks, dropping their exceptions.
+        ~TaskGroup();
+
+        /**
+         * @brief Queues a task. Tasks may spawn further tasks in the group.
+         */
+        void spawn(std::function<void()> task);
+
+        /**
+         * @brief Helps running queued tasks until every task of the group has
+         * finished, then rethrows the first exception one of them threw.
+         */
+        void wait();
+
+    private:
+        friend class ThreadPool;
+
+        ThreadPool &pool;
+        std::atomic<size_t> pending{0};
+        std::mutex errorMutex;
+        std::exception_ptr error;
+    };
+
+    /**
+     * @brief Work-stealing pool. Every thread owns a deque: it pushes and pops
+     * its own tasks at the back and steals from the front of the others when
+     * it runs out. Threads outside the pool share slot 0 with the thread that
+     * is waiting, which is why a pool of numThreads starts numThreads - 1
+     * workers. A thread waiting for tasks runs queued ones meanwhile, so
+     * nested parallelism never blocks a thread nor oversubscribes the CPU.
+     */
+    class ThreadPool
+    {
+    public:
+        /**
+         * @param pinThreads Bind worker i to the i-th CPU the process may run
+         * on, when there are enough of them.
+         */
+        explicit ThreadPool(size_t numThreads, bool pinThreads = false);
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+        ~ThreadPool();
+
+        size_t getNumThreads() const { return queues.size(); }
+
+        /**
+         * @brief Calls body(begin, end) on at most maxChunks disjoint ranges
+         * covering [0, n), each at least grain long unless n is smaller.
+         * The calling thread runs the first range itself.
+         */
+        void parallelFor(size_t n, size_t grain, size_t maxChunks,
+                         const std::function<void(size_t, size_t)> &body);
+
+    private:
+        friend class TaskGroup;
+
+        struct Task
+        {
+            std::function<void()> fn;
+            TaskGroup *group;
+        };
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        void push(Task task);
+        // Pops a task of this thread or steals one, and runs it.
+        bool runOne();
+        void waitFor(TaskGroup &group);
+        void workerLoop(size_t index, int cpu);
+        // Wakes sleeping threads if any, after queued or a group changed.
+        void notify(bool all);
+
+        vector<std::unique_ptr<Queue>> queues;
+        vector<std::thread> workers;
+        std::atomic<size_t> queued{0};
+        std::atomic<size_t> sleepers{0};
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        bool stopping = false;
+    };
+
+} // namespace infini
@@ -0,0 +1,88 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+
+namespace infini {
+class RuntimeObj;
+
+namespace cpu {
+
+/**
+ * @brief Work done on C as its tiles are stored after the last K step, while
+ * they are still in registers: C = min(max(C + bias, min), max).
+ *
+ * The bias element added to C[i, j] is bias[i * biasRowStride + j *
+ * biasColStride], with a stride of 0 along each dim the bias is broadcast
+ * over; biasColStride is 0 or 1. The same bias is used for every batch.
+ * Bounds are applied with min <= max.
+ */
+struct GemmEpilogue {
+    const float *bias = nullptr;
+    size_t biasRowStride = 0, biasColStride = 0;
+    float min = -INFINITY, max = INFINITY;
+
+    bool empty() const {
+        return !bias && min == -INFINITY && max == INFINITY;
+    }
+};
+
+/**
+ * @brief Single precision GEMM on row-major matrices:
+ * C[M, N] = op(A)[M, K] * op(B)[K, N].
+ *
+ * `transA`/`transB` follow the MatmulObj convention: when set, the operand is
+ * stored as [K, M] (resp. [N, K]) and is read transposed while it is packed,
+ * so no transposed copy is ever materialized. `lda`, `ldb` and `ldc` are the
+ * row strides (in elements) of the stored matrices.
+ *
+ * The computation is cache blocked (KC x NC panels of B, MC x KC panels of A)
+ * and register tiled; the micro kernel is selected at runtime among AVX-512,
+ * AVX2/FMA and a portable scalar implementation. Work is split with
+ * `context->parallelFor`, or runs on the calling thread without a context.
+ * The epilogue is fused into the stores of the micro kernel.
+ */
+void sgemm(bool transA, bool transB, size_t M, size_t N, size_t K,
+           const float *A, size_t lda, const float *B, size_t ldb, float *C,
+           size_t ldc, const RuntimeObj *context = nullptr,
+           const GemmEpilogue &epilogue = {});
+
+/**
+ * @brief Batched sgemm: C + b * strideC = op(A + offsetsA[b]) *
+ * op(B + offsetsB[b]) for b in [0, batch).
+ *
+ * Batches whose B offsets are equal (broadcast B) share one packed copy of B,
+ * and likewise for A.
+ * Work is distributed over batches, or over (batch, M block, N chunk) tiles
+ * when there are too few batches to occupy every thread.
+ *
+ * `packedB`, when set, holds every matrix of B already packed by
+ * sgemmPackB(): the one at offset i * K * N of B at packedB + i *
+ * sgemmPackedBSize(N, K). B is then not read nor packed again.
+ */
+void sgemmBatched(bool transA, bool transB, size_t M, size_t N, size_t K,
+                  const float *A, size_t lda, const size_t *offsetsA,
+                  const float *B, size_t ldb, const size_t *offsetsB,
+                  float *C, size_t ldc, size_t strideC, size_t batch,
+                  const RuntimeObj *context = nullptr,
+                  const GemmEpilogue &epilogue = {},
+                  const float *packedB = nullptr);
+
+/**
+ * @brief Floats taken by one op(B)[K, N] packed by sgemmPackB().
+ */
+size_t sgemmPackedBSize(size_t N, size_t K);
+
+/**
+ * @brief Packs op(B)[K, N] into the panels the micro kernel reads, so that a
+ * constant B is packed once instead of by every multiplication.
+ */
+void sgemmPackB(bool transB, size_t N, size_t K, const float *B, size_t ldb,
+                float *packed, const RuntimeObj *context = nullptr);
+
+/**
+ * @brief Name of the micro kernel selected for this machine, e.g. "avx2".
+ */
+const char *sgemmKernelName();
+
+} // namespace cpu
+} // namespace infini
@@ -28,7 +28,13 @@ namespace infini
     std::string toString() const override;
     int numInputs() const override { return 2; }
     int numOutputs() const override { return 1; }
-    };
+    bool supportsInplace() const override { return true; }
+    size_t getFlops() const override { return outputs[0]->size(); }
+    vector<int> getOpAttrVector() const override
+    {
+      return {type.underlying()};
+    }
+  };
 
 #define DEFINE_ELEMENT_WISE_OBJ(prefix, type)                    \
   class prefix##Obj : public ElementWiseObj                      \
@@ -0,0 +1,70 @@
+#pragma once
+#include "core/operator.h"
+#include <cmath>
+
+namespace infini
+{
+  /**
+   * @brief One instruction of the program of a FusedElementWiseObj. The
+   * program is in postfix order and runs on a stack of values per output
+   * element: Input pushes the (broadcast) element of an input, binary codes
+   * pop two values and push the result, Relu and Clip replace the top.
+   */
+  struct FusedStep
+  {
+    enum Code : uint8_t
+    {
+      Input,
+      Add,
+      Sub,
+      Mul,
+      Div,
+      Relu,
+      Clip,
+    } code;
+    // Index in the inputs of the op, for Input.
+    int input = 0;
+    // Bounds of Clip, infinite when absent.
+    float min = -INFINITY, max = INFINITY;
+  };
+
+  /**
+   * @brief Element-wise expression over inputs broadcast to the output
+   * shape, produced by fusing chains of Add, Sub, Mul, Div, Relu and Clip so
+   * that intermediates are never written to memory.
+   */
+  class FusedElementWiseObj : public OperatorObj
+  {
+  public:
+    FusedElementWiseObj(GraphObj *graph, TensorVec inputs, Tensor output,
+                        vector<FusedStep> program);
+    OP_CLONE(FusedElementWiseObj);
+    optional<vector<Shape>> inferShape(const TensorVec &inputs) override;
+
+    std::string toString() const override;
+    int numInputs() const override { return inputs.size(); }
+    int numOutputs() const override { return 1; }
+    bool supportsInplace() const override { return true; }
+    size_t getFlops() const override;
+    vector<int> getOpAttrVector() const override;
+
+    const vector<FusedStep> &getProgram() const { return program; }
+    // Deepest stack the program uses.
+    size_t getStackDepth() const { return stackDepth; }
+
+    /**
+     * @brief Whether op can be part of a fused expression.
+     */
+    static bool isFusible(const Operator &op);
+
+    /**
+     * @brief The program that computes op from its own inputs.
+     */
+    static vector<FusedStep> programOf(const Operator &op);
+
+  private:
+    vector<FusedStep> program;
+    size_t stackDepth = 0;
+  };
+
+}; // namespace infini
@@ -1,5 +1,6 @@
 #pragma once
 #include "core/operator.h"
+#include <cmath>
 
 namespace infini
 {
@@ -15,8 +16,10 @@ namespace infini
         // oppsite to the column-major BLAS.
         bool transA, transB;
 
-        // Auxiliary attributes which are not a part of operator attributes.
-        int m, n, k;
+        // Epilogue folded in by the optimizer: the output is
+        // min(max(A * B + bias, clipMin), clipMax), bias being the optional
+        // third input, broadcast over the output matrix.
+        float clipMin = -INFINITY, clipMax = INFINITY;
 
     public:
         /**
@@ -47,14 +50,47 @@ namespace infini
 
         int numInputs() const override { return inputs.size(); }
         int numOutputs() const override { return 1; }
+        // A multiply and an add per output element and step of K, plus the
+        // epilogue.
+        size_t getFlops() const override
+        {
+            size_t epilogue = (getBias() ? 1 : 0) + (hasClip() ? 1 : 0);
+            return (2 * size_t(getK()) + epilogue) * outputs[0]->size();
+        }
 
         bool getTransA() const { return transA; }
         bool getTransB() const { return transB; }
         void setTransA(bool transA) { this->transA = transA; }
         void setTransB(bool transB) { this->transB = transB; }
-        int getM() const { return m; }
-        int getN() const { return n; }
-        int getK() const { return k; }
+        Tensor getBias() const
+        {
+            return inputs.size() > 2 ? inputs[2] : nullptr;
+        }
+        float getClipMin() const { return clipMin; }
+        float getClipMax() const { return clipMax; }
+        bool hasClip() const
+        {
+            return clipMin != -INFINITY || clipMax != INFINITY;
+        }
+        /**
+         * @brief Clamps the output into [min, max] after the current
+         * epilogue, min <= max.
+         */
+        void fuseClip(float min, float max);
+        /**
+         * @brief Whether bias, added to the output, can be folded in: it is
+         * broadcast to the output dims without varying across batches, and
+         * no bias nor clip is folded in yet.
+         */
+        bool canFuseBias(const Tensor &bias) const;
+        /**
+         * @brief Sizes of the matrix product, from the current input dims,
+         * so that they follow shape changes.
+         */
+        int getM() const;
+        int getN() const;
+        int getK() const;
+        vector<int> getOpAttrVector() const override;
     };
 
 } // namespace infini
\ No newline at end of file
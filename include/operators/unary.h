@@ -24,6 +24,12 @@ namespace infini
     std::string toString() const override;
     int numInputs() const override { return 1; }
     int numOutputs() const override { return 1; }
+    bool supportsInplace() const override { return true; }
+    size_t getFlops() const override { return outputs[0]->size(); }
+    vector<int> getOpAttrVector() const override
+    {
+      return {type.underlying()};
+    }
   };
 
   class ClipObj : public OperatorObj
@@ -39,6 +45,9 @@ namespace infini
     std::optional<float> getMax() const { return maxValue; };
     int numInputs() const override { return 1; }
     int numOutputs() const override { return 1; }
+    bool supportsInplace() const override { return true; }
+    size_t getFlops() const override { return outputs[0]->size(); }
+    vector<int> getOpAttrVector() const override;
 
   private:
     std::optional<float> minValue, maxValue;
@@ -86,6 +95,10 @@ namespace infini
     DataType getOutputDataType() const;
     int numInputs() const override { return 1; }
     int numOutputs() const override { return 1; }
+    vector<int> getOpAttrVector() const override
+    {
+      return {type.underlying(), static_cast<int>(castType)};
+    }
 
   private:
     CastType castType;
@@ -1,13 +1,17 @@
 #include "core/allocator.h"
+#include <algorithm>
 #include <utility>
 
 namespace infini
 {
-    Allocator::Allocator(Runtime runtime) : runtime(runtime)
+    Allocator::Allocator(Runtime runtime, AllocPolicy policy)
+        : runtime(runtime), policy(policy)
     {
         used = 0;
         peak = 0;
         ptr = nullptr;
+        capacity = 0;
+        bound = false;
 
         // 'alignment' defaults to sizeof(uint64_t), because it is the length of
         // the longest data type currently supported by the DataType field of
@@ -21,8 +25,8 @@ namespace infini
     }
     // Allocates a block of memory of the given size
     size_t Allocator::alloc(size_t size) {
-        // Ensure that the pointer is null before allocation
-        IT_ASSERT(this->ptr == nullptr);
+        // Ensure that the plan is not bound to memory yet
+        IT_ASSERT(!this->bound, "Call reset() to plan again");
 
         // Pad the size to the multiple of alignment
         size = this->getAlignedSize(size);
@@ -32,27 +36,41 @@ namespace infini
         // Update the used memory counter
         this->used += size;
 
-        // Iterate through the list of free blocks to find a suitable block
-        for (auto it = this->free_blocks.begin(); it != this->free_blocks.end(); it++) {
-            // Check if the current block is large enough
-            if (it->second >= size) {
-                size_t addr = it->first; // Address of the free block
-                size_t space = it->second - size; // Remaining space after allocation
-
-                // Remove the current block from the free list
-                this->free_blocks.erase(it);
-
-                // If there is remaining space, add it back to the free list
-                if (space > 0) {
-                    this->free_blocks[addr + size] = space;
-                }
+        // Find a free block that is large enough
+        auto it = this->free_blocks.end();
+        if (this->policy == AllocPolicy::BestFit) {
+            auto fit = this->free_blocks_by_size.lower_bound({size, 0});
+            if (fit != this->free_blocks_by_size.end())
+                it = this->free_blocks.find(fit->second);
+        } else {
+            it = std::find_if(this->free_blocks.begin(), this->free_blocks.end(),
+                              [size](auto const &block) {
+                                  return block.second >= size;
+                              });
+        }
+        if (it != this->free_blocks.end()) {
+            size_t addr = it->first; // Address of the free block
+            size_t space = it->second - size; // Remaining space after allocation
+            this->eraseFreeBlock(it);
+            // If there is remaining space, add it back to the free list
+            if (space > 0)
+                this->insertFreeBlock(addr + size, space);
+            return addr;
+        }
 
-                // Return the address of the allocated block
+        // No block fits: if the last free block ends at the peak, grow it in
+        // place instead of leaving it behind as a hole.
+        if (!this->free_blocks.empty()) {
+            auto last = std::prev(this->free_blocks.end());
+            if (last->first + last->second == this->peak) {
+                size_t addr = last->first;
+                this->peak = addr + size;
+                this->eraseFreeBlock(last);
                 return addr;
             }
         }
 
-        // If no suitable block was found, increase the peak memory usage
+        // Otherwise extend the memory pool
         this->peak += size;
 
         // Return the address of the newly allocated block
@@ -61,44 +79,71 @@ namespace infini
 
 
     void Allocator::free(size_t addr, size_t size) {
-        IT_ASSERT(this->ptr == nullptr);
+        IT_ASSERT(!this->bound, "Call reset() to plan again");
         size = getAlignedSize(size);
         // =================================== 作业 ===================================
         // TODO: 设计一个算法来回收内存
         // =================================== 作业 ===================================
+        // 'peak' is the high-water mark of the plan and never shrinks: tensors
+        // placed above a freed tail block still need that memory.
         this->used -= size;
-        if (addr + size == this->peak) {
-            this->peak -= size;
-            return;
+
+        // Coalesce with the neighbours, found by address in O(log n)
+        auto next = this->free_blocks.lower_bound(addr);
+        if (next != this->free_blocks.end() && next->first == addr + size) {
+            size += next->second;
+            next = std::next(next);
+            this->eraseFreeBlock(std::prev(next));
         }
-        for (auto it = this->free_blocks.begin(); it != this->free_blocks.end();
-            it++) {
-            if (it->first + it->second == addr) {
-                it->second += size;
-                return;
-            }
-            if (it->first == addr + size) {
-                this->free_blocks[addr] = size + it->second;
-                this->free_blocks.erase(it);
-                return;
+        if (next != this->free_blocks.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == addr) {
+                addr = prev->first;
+                size += prev->second;
+                this->eraseFreeBlock(prev);
             }
         }
-        this->free_blocks[addr] = size;
+        this->insertFreeBlock(addr, size);
+    }
+
+    void Allocator::insertFreeBlock(size_t addr, size_t size)
+    {
+        this->free_blocks.emplace(addr, size);
+        this->free_blocks_by_size.emplace(size, addr);
+    }
+
+    void Allocator::eraseFreeBlock(std::map<size_t, size_t>::iterator it)
+    {
+        this->free_blocks_by_size.erase({it->second, it->first});
+        this->free_blocks.erase(it);
     }
 
     void *Allocator::getPtr()
     {
-        if (this->ptr == nullptr)
+        if (this->ptr == nullptr || this->peak > this->capacity)
         {
+            if (this->ptr != nullptr)
+                runtime->dealloc(this->ptr);
             this->ptr = runtime->alloc(this->peak);
+            this->capacity = this->peak;
             printf("Allocator really alloc: %p %lu bytes\n", this->ptr, peak);
         }
+        this->bound = true;
         return this->ptr;
     }
 
+    void Allocator::reset()
+    {
+        this->used = 0;
+        this->peak = 0;
+        this->free_blocks.clear();
+        this->free_blocks_by_size.clear();
+        this->bound = false;
+    }
+
     size_t Allocator::getAlignedSize(size_t size)
     {
-        return ((size - 1) / this->alignment + 1) * this->alignment;
+        return (size + this->alignment - 1) / this->alignment * this->alignment;
     }
 
     void Allocator::info()
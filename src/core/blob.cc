@@ -0,0 +1,18 @@
+#include "core/blob.h"
+#include "core/runtime.h"
+
+namespace infini
+{
+    BlobObj::BlobObj(Runtime runtime, size_t bytes)
+        : runtime(runtime), ptr(runtime->alloc(bytes)), owned(true)
+    {
+        IT_ASSERT(ptr != nullptr || bytes == 0);
+    }
+
+    BlobObj::~BlobObj()
+    {
+        if (owned)
+            runtime->dealloc(ptr);
+    }
+
+} // namespace infini
@@ -1,16 +1,50 @@
 #include "core/graph.h"
+#include "core/kernel.h"
 #include "core/op_type.h"
+#include "operators/concat.h"
+#include "operators/fused_element_wise.h"
 #include "operators/matmul.h"
 #include "operators/transpose.h"
+#include "operators/unary.h"
 #include <algorithm>
 #include <cstddef>
+#include <deque>
+#include <functional>
 #include <numeric>
 #include <queue>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace infini {
 
+namespace {
+
+// Successor lists in CSR form from (from, to) edges, without duplicates.
+OpDependencies buildDependencies(size_t n,
+                                 vector<pair<size_t, size_t>> edges) {
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    OpDependencies deps;
+    deps.numPredecessors.assign(n, 0);
+    deps.successorOffsets.assign(n + 1, 0);
+    deps.successors.reserve(edges.size());
+    for (auto [from, to] : edges) {
+        ++deps.successorOffsets[from + 1];
+        ++deps.numPredecessors[to];
+        deps.successors.emplace_back(to);
+    }
+    std::partial_sum(deps.successorOffsets.begin(),
+                     deps.successorOffsets.end(),
+                     deps.successorOffsets.begin());
+    return deps;
+}
+
+} // namespace
+
 void GraphObj::addOperatorAndConnect(const Operator &op) {
     sorted = false;
+    invalidatePlan();
+    opSlots[op->getGuid()] = ops.size();
     ops.push_back(op);
     for (auto &input : op->getInputs()) {
         if (input) {
@@ -54,241 +88,1133 @@ string GraphObj::toString() const {
 }
 
 bool GraphObj::topo_sort() {
+    compact();
     if (this->sorted) {
         return true;
     }
-    std::vector<Operator> sorted;
-    std::unordered_set<OperatorObj *> flags;
-    sorted.reserve(ops.size());
-    flags.reserve(ops.size());
-    while (sorted.size() < ops.size()) {
-        // Any node is move to sorted in this loop.
-        auto modified = false;
-        for (auto const &op : ops) {
-            if (auto const &inputs = op->getInputs();
-                flags.find(op.get()) == flags.end() &&
-                std::all_of(inputs.begin(), inputs.end(),
-                            [&flags](auto const &input) {
-                                auto ptr = input->getSource().get();
-                                return !ptr || flags.find(ptr) != flags.end();
-                            })) {
-                modified = true;
-                sorted.emplace_back(op);
-                flags.insert(op.get());
-            }
-        }
-        if (!modified) {
-            return false;
+    // Index ops and connect each one to its in-graph producers.
+    const size_t n = ops.size();
+    std::unordered_map<OperatorObj *, size_t> index;
+    index.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        index.emplace(ops[i].get(), i);
+    vector<pair<size_t, size_t>> edges; // (producer, consumer)
+    for (size_t i = 0; i < n; ++i) {
+        for (auto const &input : ops[i]->getInputs()) {
+            auto source = input->getSource();
+            if (!source)
+                continue;
+            auto it = index.find(source.get());
+            // A producer outside the graph can never be scheduled.
+            if (it == index.end())
+                return false;
+            edges.emplace_back(it->second, i);
         }
     }
+    auto deps = buildDependencies(n, std::move(edges));
+
+    // Level-synchronous Kahn: each wavefront holds the ops whose last
+    // producer is in the previous one, in their original order, so the
+    // result only depends on the insertion order of the ops.
+    vector<size_t> inDegree = deps.numPredecessors, order, offsets{0};
+    order.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        if (inDegree[i] == 0)
+            order.emplace_back(i);
+    for (size_t begin = 0; begin < order.size();) {
+        size_t end = order.size();
+        offsets.emplace_back(end);
+        for (size_t k = begin; k < end; ++k)
+            for (size_t s = deps.successorOffsets[order[k]];
+                 s < deps.successorOffsets[order[k] + 1]; ++s)
+                if (--inDegree[deps.successors[s]] == 0)
+                    order.emplace_back(deps.successors[s]);
+        std::sort(order.begin() + end, order.end());
+        begin = end;
+    }
+    if (order.size() < n) {
+        return false;
+    }
+
+    OpVec sorted;
+    vector<size_t> position(n);
+    sorted.reserve(n);
+    for (size_t k = 0; k < n; ++k) {
+        position[order[k]] = k;
+        sorted.emplace_back(std::move(ops[order[k]]));
+    }
+    dataEdges.clear();
+    for (size_t i = 0; i < n; ++i)
+        for (size_t s = deps.successorOffsets[i];
+             s < deps.successorOffsets[i + 1]; ++s)
+            dataEdges.emplace_back(position[i], position[deps.successors[s]]);
     this->ops = std::move(sorted);
+    for (size_t k = 0; k < n; ++k)
+        opSlots[ops[k]->getGuid()] = k;
+    invalidatePlan();
+    this->levelOffsets = std::move(offsets);
+    this->dependencies = buildDependencies(n, dataEdges);
     return this->sorted = true;
 }
 
+namespace {
+
+// Bounds of a Relu or Clip, infinite when absent.
+pair<float, float> clampOf(const Operator &op) {
+    if (op->getOpType() == OpType::Relu)
+        return {0.f, INFINITY};
+    auto clip = as<ClipObj>(op);
+    return {clip->getMin().value_or(-INFINITY),
+            clip->getMax().value_or(INFINITY)};
+}
+
+vector<RewriteRule> epilogueRules() {
+    vector<RewriteRule> rules;
+    // A bias Add, Relu or Clip reading a MatMul moves into its epilogue.
+    rules.push_back(
+        {"matmul-bias", Pattern(OpType::Add).input(Pattern(OpType::MatMul)),
+         [](Rewriter &rewriter, const OpVec &match) {
+             auto mm = as<MatmulObj>(match[1]);
+             auto output = match[0]->getOutput(), product = mm->getOutput();
+             auto bias = match[0]->getInputs(0) == product
+                             ? match[0]->getInputs(1)
+                             : match[0]->getInputs(0);
+             if (bias == product || output->getDims() != product->getDims() ||
+                 !mm->canFuseBias(bias))
+                 return false;
+             auto inputs = mm->getInputs();
+             inputs.emplace_back(bias);
+             rewriter.clone(mm, inputs, {output});
+             return true;
+         }});
+    for (auto type : {OpType::Relu, OpType::Clip})
+        rules.push_back(
+            {type == OpType::Relu ? "matmul-relu" : "matmul-clip",
+             Pattern(type).input(Pattern(OpType::MatMul)),
+             [](Rewriter &rewriter, const OpVec &match) {
+                 auto [min, max] = clampOf(match[0]);
+                 if (min > max)
+                     return false;
+                 auto mm = rewriter.clone(match[1], match[1]->getInputs(),
+                                          {match[0]->getOutput()});
+                 as<MatmulObj>(mm)->fuseClip(min, max);
+                 return true;
+             }});
+    // Consecutive Relus and Clips compose into one clamp.
+    for (auto outer : {OpType::Relu, OpType::Clip})
+        for (auto inner : {OpType::Relu, OpType::Clip})
+            rules.push_back(
+                {string(outer == OpType::Relu ? "relu" : "clip") + "-" +
+                     (inner == OpType::Relu ? "relu" : "clip"),
+                 Pattern(outer).input(Pattern(inner)),
+                 [](Rewriter &rewriter, const OpVec &match) {
+                     auto [a, b] = clampOf(match[1]);
+                     auto [c, d] = clampOf(match[0]);
+                     if (a > b || c > d)
+                         return false;
+                     float min = std::min(std::max(a, c), d),
+                           max = std::min(std::max(b, c), d);
+                     auto input = match[1]->getInputs(0),
+                          output = match[0]->getOutput();
+                     if (min == 0 && max == INFINITY)
+                         rewriter.addOp<ReluObj>(input, output);
+                     else
+                         rewriter.addOp<ClipObj>(
+                             input, output,
+                             min > -INFINITY ? optional(min) : std::nullopt,
+                             max < INFINITY ? optional(max) : std::nullopt);
+                     return true;
+                 }});
+    return rules;
+}
+
+} // namespace
+
 void GraphObj::optimize() {
+    // Rewrites may change op attributes without adding or removing ops.
+    invalidatePlan();
     // =================================== 作业 ===================================
     // TODO: 设计一个算法来实现指定的图优化规则
     // 图优化规则如下：
     // 1. 去除冗余的算子（例如，两个相邻的算子都是 transpose 算子，且做的是相反的操作，可以将其全部删除）
     // 2. 合并算子（例如，矩阵乘算子中含有属性transA、transB，如果其输入存在transpose，且对最后两个维度做交换，就可以将transpose融入到矩阵乘算子的属性中去）
     // =================================== 作业 ===================================
-    // 使用一个布尔标志位finished，表示当前优化过程是否已完成
-    // 若在循环中发现能继续做优化(删除算子/合并算子)，则设finished=false，并再次循环
-    bool finished = false;   // 标记是否完成所有优化
-    while (!finished) {
-        finished = true;     // 默认假设本轮没有发生任何优化
-        bool needRestart = false; // 标记本轮是否发生了优化，若发生则需要重新扫描
-
-        // 遍历图中所有算子
-        for (auto &&prev : ops) {
-
-            // 若不是 Transpose，则跳过
-            if (prev->type != OpType::Transpose)
-                continue;
+    PassManager passes;
+    // 先对只依赖常量的子图做常量折叠，再合并重复的算子、删除无用的分支
+    passes.addPass("fold-constants",
+                   [](GraphObj &g) { return g.foldConstants(); });
+    passes.addPass("cse", [](GraphObj &g) {
+        return g.eliminateCommonSubexpressions();
+    });
+    passes.addPass("dce", [](GraphObj &g) { return g.removeDeadOperators(); });
+    // 1、2. 化简转置：合成转置链、去除恒等转置、穿过逐元素算子下推以便相互抵消，
+    // 并把只交换最后两维的转置融入矩阵乘的 transA/transB
+    passes.addPass("simplify-transposes",
+                   [](GraphObj &g) { return g.simplifyTransposes(); });
+    // 3. 将矩阵乘后的偏置加法、Relu 和 Clip 融入矩阵乘的收尾计算，合并相邻的 Relu/Clip
+    passes.addRewrites("epilogue", epilogueRules());
+    // 4. 将逐元素算子链融合为一个算子，中间结果不再写回内存
+    passes.addPass("fuse-element-wise",
+                   [](GraphObj &g) { return g.fuseElementWise(); });
+    passStats = passes.run(*this);
+    compact();
+}
 
-            // 遍历当前 Transpose 的所有后继算子
-            for (auto &&succ_w : prev->successors) {
-                auto succ = succ_w.lock();
-                if (!succ)
-                    continue;
+namespace {
 
-                // 情况1：后继也是 Transpose，且两者 permute 相同时，相当于抵消，删除
-                if (succ->type == OpType::Transpose) {
-                    auto tp_prev = as<TransposeObj>(prev);
-                    auto tp_succ = as<TransposeObj>(succ);
-
-                    // 如果 permute 相同，则可删去这两个 Transpose
-                    if (tp_prev->getPermute() == tp_succ->getPermute()) {
-                        finished = false;
-                        needRestart = true;
-
-                        // 处理后继节点的后继（即将其输入指向 prev 的输入）
-                        for (auto &&ss_w : succ->successors) {
-                            auto ss = ss_w.lock();
-                            if (!ss)
-                                continue;
-                            for (auto &&ss_input : ss->inputs) {
-                                if (ss_input == succ->outputs[0]) {
-                                    ss_input->removeTarget(ss);
-                                    removeTensor(ss_input);
-                                    ss_input = prev->inputs[0];
-                                    ss_input->removeTarget(prev);
-                                    ss_input->addTarget(ss);
-                                }
-                            }
-                            ss->removePredecessors(succ);
-                            // 把 prev 的前驱设为此节点的前驱
-                            for (auto prev_old_prev_w : prev->predecessors) {
-                                auto prev_old_prev = prev_old_prev_w.lock();
-                                if (!prev_old_prev)
-                                    continue;
-                                ss->addPredecessors(prev_old_prev);
-                                prev_old_prev->removeSuccessors(prev);
-                                prev_old_prev->addSuccessors(ss);
-                            }
-                        }
-                        // 删除 prev 的输出张量并删除两个 Transpose 算子
-                        for (auto &&prev_output : prev->outputs) {
-                            removeTensor(prev_output);
-                        }
-                        removeOperator(prev);
-                        removeOperator(succ);
-                        break; // 退出当前后继循环
-                    }
-                }
-                // 情况2：后继是 MatMul，且该 Transpose 只交换最后两个维度
-                else if (succ->type == OpType::MatMul) {
-                    auto tp_prev = as<TransposeObj>(prev);
-                    auto mm_succ = as<MatmulObj>(succ);
-
-                    auto perm = tp_prev->getPermute();
-                    auto rank = perm.size();
-                    bool valid = true;
-
-                    // 检查是否只交换了最后两个维度
-                    for (size_t i = 0; i < rank - 2; i++) {
-                        if (perm[i] != static_cast<int>(i)) {
-                            valid = false;
-                            break;
-                        }
-                    }
-                    valid = valid &&
-                            (perm[rank - 2] == static_cast<int>(rank - 1)) &&
-                            (perm[rank - 1] == static_cast<int>(rank - 2));
-
-                    if (!valid) {
-                        // 删除原有的输出调试信息
-                        continue;
-                    }
-
-                    // 合并到 MatMul 的 transA/transB
-                    finished = false;
-                    needRestart = true;
-                    mm_succ->removePredecessors(prev);
-
-                    // 替换前驱关系
-                    for (auto &&prev_old_prev_w : tp_prev->predecessors) {
-                        auto prev_old_prev = prev_old_prev_w.lock();
-                        if (!prev_old_prev)
-                            continue;
-                        prev_old_prev->removeSuccessors(prev);
-                        prev_old_prev->addSuccessors(succ);
-                        mm_succ->addPredecessors(prev_old_prev);
-                    }
-                    // 更新 MatMul 的输入，并设置 transA/transB
-                    for (auto &&succ_input : succ->inputs) {
-                        if (succ_input == prev->outputs[0]) {
-                            if (succ_input == succ->inputs[0])
-                                mm_succ->setTransA(!mm_succ->getTransA());
-                            if (succ_input == succ->inputs[1])
-                                mm_succ->setTransB(!mm_succ->getTransB());
-
-                            succ_input = prev->inputs[0];
-                            succ_input->removeTarget(prev);
-                            succ_input->addTarget(succ);
-                        }
-                    }
-                    // 删除该 Transpose 的输出张量以及算子
-                    removeTensor(prev->outputs[0]);
-                    removeOperator(prev);
-                    break; // 退出当前后继循环
+bool isIdentity(const vector<int> &perm) {
+    for (size_t i = 0; i < perm.size(); ++i)
+        if (perm[i] != static_cast<int>(i))
+            return false;
+    return true;
+}
+
+// Permutation of second(first(x)).
+vector<int> composePermutations(const vector<int> &first,
+                                const vector<int> &second) {
+    vector<int> ret(second.size());
+    for (size_t i = 0; i < second.size(); ++i)
+        ret[i] = first[second[i]];
+    return ret;
+}
+
+// Whether perm only swaps the last two dims, which MatMul does by itself.
+bool swapsLastTwo(const vector<int> &perm) {
+    auto rank = perm.size();
+    if (rank < 2)
+        return false;
+    auto swapped = perm;
+    std::swap(swapped[rank - 2], swapped[rank - 1]);
+    return isIdentity(swapped);
+}
+
+// Element-wise ops a Transpose commutes with.
+bool isElementWise(const Operator &op) {
+    switch (op->getOpType().underlying()) {
+    case OpType::Add:
+    case OpType::Sub:
+    case OpType::Mul:
+    case OpType::Div:
+    case OpType::Relu:
+    case OpType::Clip:
+    case OpType::Cast:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// The Transpose by perm that produces t for a single reader, if any.
+Ref<TransposeObj> sameTranspose(const Tensor &t, const vector<int> &perm) {
+    auto source = t->getSource();
+    if (!source || source->getOpType() != OpType::Transpose ||
+        t->getTargets().size() != 1)
+        return nullptr;
+    auto transpose = as<TransposeObj>(source);
+    return transpose->getPermute() == perm ? transpose : nullptr;
+}
+
+} // namespace
+
+size_t GraphObj::simplifyTransposes() {
+    compact();
+    // Transposes left to visit. Ops a rewrite adds are appended to ops, and
+    // only Transposes around them can have become rewritable: their
+    // readers, and the producers above them through the single-reader
+    // element-wise chains that canSink() walks down.
+    std::deque<Ref<TransposeObj>> worklist;
+    std::unordered_set<OperatorObj *> queued;
+    auto enqueue = [&](const Operator &op) {
+        if (op->getOpType() == OpType::Transpose &&
+            queued.insert(op.get()).second)
+            worklist.emplace_back(as<TransposeObj>(op));
+    };
+    auto enqueueAround = [&](const Operator &op) {
+        enqueue(op);
+        for (auto &output : op->getOutputs())
+            for (auto &reader : output->getTargets())
+                enqueue(reader);
+        OpVec above{op};
+        while (!above.empty()) {
+            auto next = above.back();
+            above.pop_back();
+            for (auto &input : next->getInputs())
+                if (auto source = input->getSource()) {
+                    enqueue(source);
+                    if (isElementWise(source) &&
+                        input->getTargets().size() == 1)
+                        above.emplace_back(source);
                 }
+        }
+    };
+    for (auto &op : ops)
+        enqueue(op);
+
+    // Every rewrite removes a Transpose or moves one closer to the
+    // Transpose or MatMul it merges into, so this terminates.
+    size_t rewrites = 0;
+    while (!worklist.empty()) {
+        auto transpose = worklist.front();
+        worklist.pop_front();
+        queued.erase(transpose.get());
+        size_t added = ops.size();
+        if (!hasOperator(transpose) || !simplifyTranspose(transpose))
+            continue;
+        ++rewrites;
+        for (size_t i = added; i < ops.size(); ++i)
+            if (ops[i])
+                enqueueAround(ops[i]);
+    }
+    compact();
+    return rewrites;
+}
+
+Tensor GraphObj::sinkInputOf(const Ref<TransposeObj> &transpose,
+                             const Operator &op) const {
+    auto t = transpose->getOutput();
+    if (op->numInputs() == 1)
+        return t;
+    // The other operand must be transposed the same way, or be a scalar
+    // that broadcasts the same in any layout.
+    auto other = op->getInputs(0) == t ? op->getInputs(1) : op->getInputs(0);
+    if (other == t ||
+        (sameTranspose(other, transpose->getPermute()) &&
+         !isMarkedOutput(other)) ||
+        (other->size() == 1 && other->getRank() <= t->getRank()))
+        return other;
+    return nullptr;
+}
+
+bool GraphObj::canSink(const Ref<TransposeObj> &transpose) const {
+    auto perm = transpose->getPermute();
+    auto targets = transpose->getOutput()->getTargets();
+    if (isMarkedOutput(transpose->getOutput()) ||
+        (targets.size() != 1 &&
+         !(targets.size() == 2 && targets[0] == targets[1])))
+        return false;
+    auto op = targets[0];
+    if (!isElementWise(op) || !sinkInputOf(transpose, op))
+        return false;
+    // Only worth it when the Transpose, once below op, merges into what
+    // follows: walk down the single-consumer chain op starts.
+    for (auto t = op->getOutput();;) {
+        auto next = t->getTargets();
+        if (next.size() != 1)
+            return false;
+        auto consumer = next[0];
+        if (consumer->getOpType() == OpType::Transpose)
+            return true;
+        if (consumer->getOpType() == OpType::MatMul)
+            return swapsLastTwo(perm) && (consumer->getInputs(0) == t ||
+                                          consumer->getInputs(1) == t);
+        if (!isElementWise(consumer) || consumer->numInputs() != 1)
+            return false;
+        t = consumer->getOutput();
+    }
+}
+
+bool GraphObj::simplifyTranspose(const Ref<TransposeObj> &transpose) {
+    auto x = transpose->getInputs(0), t = transpose->getOutput();
+    auto perm = transpose->getPermute();
+    auto targets = t->getTargets();
+    targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+    // An identity is bypassed. When its output is an output of the graph,
+    // the producer of its input writes that output instead.
+    if (isIdentity(perm)) {
+        auto producer = x->getSource();
+        if (!targets.empty()) {
+            replaceAllUses(t, x);
+            if (!isMarkedOutput(t)) {
+                detachOperator(transpose);
+                eraseTensor(t);
+            }
+            return true;
+        }
+        if (!producer || x->getTargets().size() != 1 || isMarkedOutput(x))
+            return false;
+        detachOperator(transpose);
+        detachOperator(producer);
+        std::replace(producer->outputs.begin(), producer->outputs.end(), x, t);
+        addOperatorAndConnect(producer);
+        eraseTensor(x);
+        return true;
+    }
+    if (targets.empty())
+        return false;
+    bool changed = false;
+    for (auto &consumer : targets) {
+        // A following Transpose reads x with the composed permutation. This
+        // one stays for its other readers, if any.
+        if (consumer->getOpType() == OpType::Transpose) {
+            auto next = as<TransposeObj>(consumer);
+            auto composed = composePermutations(perm, next->getPermute());
+            auto output = next->getOutput();
+            detachOperator(next);
+            addOpWithOutputs<TransposeObj>(x, output, composed);
+            changed = true;
+        }
+        // MatMul transposes the last two dims of its operands by itself.
+        if (consumer->getOpType() == OpType::MatMul && swapsLastTwo(perm)) {
+            auto mm = as<MatmulObj>(consumer);
+            detachOperator(mm);
+            if (mm->inputs[0] == t) {
+                mm->inputs[0] = x;
+                mm->setTransA(!mm->getTransA());
+            }
+            if (mm->inputs[1] == t) {
+                mm->inputs[1] = x;
+                mm->setTransB(!mm->getTransB());
             }
+            addOperatorAndConnect(mm);
+            changed = true;
+        }
+    }
+    if (changed) {
+        if (t->getTargets().empty() && !isMarkedOutput(t)) {
+            detachOperator(transpose);
+            eraseTensor(t);
+        }
+        return true;
+    }
+    if (!canSink(transpose))
+        return false;
 
-            // 若本轮已进行优化操作，需要重新扫描，跳出当前for循环
-            if (needRestart) {
-                break;
+    // Moves below its only reader, an element-wise op, on the way to what
+    // it merges with: op(T(x), T(y)) = T(op(x, y)).
+    auto op = targets[0];
+    auto other = sinkInputOf(transpose, op);
+    auto partner = other == t ? nullptr : sameTranspose(other, perm);
+    auto output = op->getOutput();
+    Shape dims(output->getRank());
+    for (size_t i = 0; i < perm.size(); ++i)
+        dims[perm[i]] = output->getDims()[i];
+    auto inner = addTensor(dims, output->getDType());
+    detachOperator(op);
+    op->replaceInput(t, x);
+    if (partner)
+        op->replaceInput(other, partner->getInputs(0));
+    op->outputs[0] = inner;
+    addOperatorAndConnect(op);
+    addOpWithOutputs<TransposeObj>(inner, output, perm);
+    for (auto &dropped : {Operator(transpose), Operator(partner)})
+        if (dropped) {
+            eraseTensor(dropped->getOutput());
+            detachOperator(dropped);
+        }
+    return true;
+}
+
+void GraphObj::detachOperator(const Operator &op) {
+    for (auto &input : op->getInputs())
+        input->removeTarget(op);
+    for (auto &output : op->getOutputs())
+        if (output->getSource() == op)
+            output->source.reset();
+    for (auto &pred : op->getPredecessors())
+        pred->removeSuccessors(op);
+    for (auto &succ : op->getSuccessors())
+        succ->removePredecessors(op);
+    op->predecessors.clear();
+    op->successors.clear();
+    eraseOperator(op);
+}
+
+void GraphObj::replaceAllUses(const Tensor &from, const Tensor &to) {
+    auto readers = from->getTargets();
+    readers.erase(std::unique(readers.begin(), readers.end()), readers.end());
+    for (auto &reader : readers) {
+        detachOperator(reader);
+        reader->replaceInput(from, to);
+        addOperatorAndConnect(reader);
+    }
+}
+
+vector<size_t> GraphObj::applyRewrites(const vector<RewriteRule> &rules) {
+    compact();
+    std::unordered_map<OpType::underlying_t, vector<size_t>> rulesOf;
+    int depth = 0;
+    for (size_t i = 0; i < rules.size(); ++i) {
+        rulesOf[rules[i].pattern.getType().underlying()].emplace_back(i);
+        depth = std::max(depth, rules[i].pattern.depth());
+    }
+    auto isOutput = [this](const Tensor &t) { return isMarkedOutput(t); };
+
+    // Roots left to visit. A replacement can complete matches rooted at its
+    // ops and up to depth - 1 readers below them, and frees the tensors the
+    // match read for matches rooted at their other readers.
+    std::deque<Operator> worklist;
+    std::unordered_set<OperatorObj *> queued;
+    auto enqueue = [&](const Operator &op) {
+        if (rulesOf.count(op->getOpType().underlying()) &&
+            queued.insert(op.get()).second)
+            worklist.emplace_back(op);
+    };
+    for (auto &op : ops)
+        enqueue(op);
+
+    vector<size_t> counts(rules.size());
+    while (!worklist.empty()) {
+        auto op = worklist.front();
+        worklist.pop_front();
+        queued.erase(op.get());
+        if (!hasOperator(op))
+            continue;
+        for (auto i : rulesOf.at(op->getOpType().underlying())) {
+            OpVec match;
+            if (!rules[i].pattern.match(op, isOutput, match))
+                continue;
+            Rewriter rewriter(*this);
+            if (!rules[i].apply(rewriter, match)) {
+                for (auto &t : rewriter.getTensors())
+                    eraseTensor(t);
+                continue;
             }
+            TensorVec read;
+            for (auto &matched : match)
+                for (auto &input : matched->getInputs())
+                    read.emplace_back(input);
+            replaceMatch(match, rewriter.getOps());
+            ++counts[i];
+
+            OpVec frontier = rewriter.getOps();
+            for (auto &t : read)
+                for (auto &reader : t->getTargets())
+                    frontier.emplace_back(reader);
+            for (int d = 0; d < depth && !frontier.empty(); ++d) {
+                OpVec next;
+                for (auto &o : frontier) {
+                    enqueue(o);
+                    for (auto &output : o->getOutputs())
+                        for (auto &reader : output->getTargets())
+                            next.emplace_back(reader);
+                }
+                frontier = std::move(next);
+            }
+            break;
         }
+    }
+    compact();
+    return counts;
+}
 
-        // 若本轮有优化发生，则继续重新扫描
-        if (needRestart) {
+void GraphObj::replaceMatch(const OpVec &match, const OpVec &replacement) {
+    TensorVec interior;
+    for (size_t i = 1; i < match.size(); ++i)
+        for (auto &output : match[i]->getOutputs())
+            interior.emplace_back(output);
+    for (auto &op : match)
+        detachOperator(op);
+    for (auto &op : replacement)
+        addOperatorAndConnect(op);
+    for (auto &output : match[0]->getOutputs())
+        IT_ASSERT(output->getSource(),
+                  "A rewrite must produce the outputs of the matched root");
+    // Intermediates of the match not produced again are gone.
+    for (auto &t : interior)
+        if (!t->getSource()) {
+            IT_ASSERT(t->getTargets().empty(),
+                      "A rewrite must not read intermediates it removes");
+            eraseTensor(t);
+        }
+}
+
+size_t GraphObj::eliminateCommonSubexpressions() {
+    IT_ASSERT(topo_sort(), "Graph has a cycle");
+    // Earlier ops by hash. In topological order, inputs are already merged
+    // when an op is visited, so chains of duplicates collapse in one pass.
+    std::unordered_map<size_t, OpVec> seen;
+    size_t merged = 0;
+    for (auto &op : OpVec(ops)) {
+        auto &candidates = seen[op->hash()];
+        auto it = std::find_if(candidates.begin(), candidates.end(),
+                               [&](const Operator &candidate) {
+                                   return candidate->isEquivalent(*op);
+                               });
+        auto results = op->getOutputs();
+        // Outputs of the graph are kept, as whoever holds them expects them
+        // to be computed.
+        if (it == candidates.end() ||
+            std::any_of(results.begin(), results.end(), [&](auto &t) {
+                return isMarkedOutput(t) ||
+                       (outputs.empty() && t->getTargets().empty());
+            })) {
+            candidates.emplace_back(op);
             continue;
         }
+        for (size_t i = 0; i < results.size(); ++i) {
+            replaceAllUses(results[i], (*it)->getOutput(i));
+            eraseTensor(results[i]);
+        }
+        detachOperator(op);
+        ++merged;
     }
+    compact();
+    return merged;
 }
 
-Tensor GraphObj::getTensor(int fuid) const {
-    for (auto tensor : tensors) {
-        if (tensor->getFuid() == fuid) {
-            return tensor;
+size_t GraphObj::removeDeadOperators() {
+    compact();
+    std::unordered_set<OperatorObj *> live;
+    OpVec stack;
+    for (auto &output : getOutputs())
+        if (auto source = output->getSource())
+            if (live.insert(source.get()).second)
+                stack.emplace_back(source);
+    while (!stack.empty()) {
+        auto op = stack.back();
+        stack.pop_back();
+        for (auto &input : op->getInputs())
+            if (auto source = input->getSource())
+                if (live.insert(source.get()).second)
+                    stack.emplace_back(source);
+    }
+    const size_t dead = ops.size() - live.size();
+    if (dead == 0)
+        return 0;
+
+    TensorVec touched;
+    for (auto &op : OpVec(ops)) {
+        if (live.count(op.get()))
+            continue;
+        touched.insert(touched.end(), op->getInputs().begin(),
+                       op->getInputs().end());
+        touched.insert(touched.end(), op->getOutputs().begin(),
+                       op->getOutputs().end());
+        detachOperator(op);
+    }
+    for (auto &t : touched)
+        if (!t->getSource() && t->getTargets().empty() && !isMarkedOutput(t))
+            eraseTensor(t);
+    compact();
+    return dead;
+}
+
+size_t GraphObj::foldConstants() {
+    IT_ASSERT(topo_sort(), "Graph has a cycle");
+    const auto &registry = KernelRegistry::getInstance();
+    size_t folded = 0;
+    // In topological order, so the outputs of folded ops are constants by
+    // the time their readers are visited.
+    for (auto &op : OpVec(ops)) {
+        auto inputs = op->getInputs();
+        if (!std::all_of(inputs.begin(), inputs.end(),
+                         [](const Tensor &t) { return t->isConstant(); }))
+            continue;
+        for (auto &output : op->getOutputs()) {
+            output->source.reset();
+            output->setConstant();
         }
+        registry.getKernel({runtime->getDevice(), op->getOpType().underlying()})
+            ->compute(op, runtime.get());
+
+        for (auto &input : inputs) {
+            input->removeTarget(op);
+            // Constants read by nothing else are no longer needed.
+            if (input->getTargets().empty() && !isMarkedOutput(input))
+                eraseTensor(input);
+        }
+        for (auto &succ : op->getSuccessors())
+            succ->removePredecessors(op);
+        eraseOperator(op);
+        ++folded;
     }
-    return nullptr;
+    compact();
+    return folded;
 }
 
-void GraphObj::shape_infer() {
-    for (auto &op : ops) {
+size_t GraphObj::fuseElementWise() {
+    compact();
+    // An op is absorbed into the only consumer of its output when both are
+    // fusible and compute the same elements, so that the output becomes a
+    // per-element temporary of the consumer. It is inlined once per use,
+    // so consumers reading it more than once are left alone.
+    auto absorberOf = [this](const Operator &op) -> Operator {
+        if (!FusedElementWiseObj::isFusible(op))
+            return nullptr;
+        auto output = op->getOutput();
+        auto targets = output->getTargets();
+        if (targets.size() != 1 || isMarkedOutput(output))
+            return nullptr;
+        auto succ = targets[0];
+        if (!FusedElementWiseObj::isFusible(succ) ||
+            succ->getOutput()->getDims() != output->getDims() ||
+            !(succ->getDType() == op->getDType()))
+            return nullptr;
+        int uses = 0;
+        for (const auto &step : FusedElementWiseObj::programOf(succ))
+            uses += step.code == FusedStep::Input &&
+                    succ->getInputs(step.input) == output;
+        return uses == 1 ? succ : nullptr;
+    };
+
+    // Keyed by Ref so that ops removed below are not reallocated at the
+    // same address while the map is in use.
+    std::unordered_map<Operator, Operator> absorber;
+    std::unordered_set<Operator> absorbing;
+    for (auto &op : ops)
+        if (auto succ = absorberOf(op)) {
+            absorber.emplace(op, succ);
+            absorbing.insert(succ);
+        }
+    // Roots absorb others without being absorbed; each becomes one op.
+    OpVec roots;
+    for (auto &op : ops)
+        if (absorbing.count(op) && !absorber.count(op))
+            roots.emplace_back(op);
+
+    for (auto &root : roots) {
+        // Postfix program of the whole tree, with the absorbed producers
+        // inlined in place of their outputs.
+        TensorVec externals;
+        vector<FusedStep> program;
+        OpVec members;
+        std::function<void(const Operator &)> emit = [&](const Operator &op) {
+            members.emplace_back(op);
+            for (auto step : FusedElementWiseObj::programOf(op)) {
+                if (step.code != FusedStep::Input) {
+                    program.emplace_back(step);
+                    continue;
+                }
+                auto input = op->getInputs(step.input);
+                auto source = input->getSource();
+                if (source && absorber.count(source)) {
+                    emit(source);
+                    continue;
+                }
+                auto it = std::find(externals.begin(), externals.end(), input);
+                step.input = it - externals.begin();
+                if (it == externals.end())
+                    externals.emplace_back(input);
+                program.emplace_back(step);
+            }
+        };
+        emit(root);
+
+        for (auto &member : members) {
+            for (auto &input : member->getInputs()) {
+                input->removeTarget(member);
+                if (auto source = input->getSource())
+                    source->removeSuccessors(member);
+            }
+            for (auto &succ : member->getSuccessors())
+                succ->removePredecessors(member);
+            if (member != root)
+                eraseTensor(member->getOutput());
+            eraseOperator(member);
+        }
+        addOpWithOutputs<FusedElementWiseObj>(externals, root->getOutput(),
+                                              program);
+    }
+    // The fused ops were appended after their consumers.
+    if (!roots.empty())
+        IT_ASSERT(topo_sort());
+    return roots.size();
+}
+
+Tensor GraphObj::getTensor(int fuid) const {
+    auto it = tensorSlots.find(fuid);
+    return it == tensorSlots.end() ? nullptr : tensors[it->second];
+}
+
+bool GraphObj::hasOperator(const Operator &op) const {
+    auto it = opSlots.find(op->getGuid());
+    return it != opSlots.end() && ops[it->second] == op;
+}
+
+bool GraphObj::hasTensor(const Tensor &tensor) const {
+    auto it = tensorSlots.find(tensor->getFuid());
+    return it != tensorSlots.end() && tensors[it->second] == tensor;
+}
+
+void GraphObj::eraseOperator(const Operator &op) {
+    auto it = opSlots.find(op->getGuid());
+    if (it == opSlots.end() || ops[it->second] != op)
+        return;
+    ops[it->second] = nullptr;
+    opSlots.erase(it);
+    shapeMemo.erase(op->getGuid());
+    ++holes;
+    sorted = false;
+    invalidatePlan();
+}
+
+void GraphObj::eraseTensor(const Tensor &tensor) {
+    auto it = tensorSlots.find(tensor->getFuid());
+    if (it == tensorSlots.end() || tensors[it->second] != tensor)
+        return;
+    tensors[it->second] = nullptr;
+    tensorSlots.erase(it);
+    ++holes;
+}
+
+void GraphObj::compact() {
+    if (holes == 0)
+        return;
+    ops.erase(std::remove(ops.begin(), ops.end(), nullptr), ops.end());
+    tensors.erase(std::remove(tensors.begin(), tensors.end(), nullptr),
+                  tensors.end());
+    opSlots.clear();
+    tensorSlots.clear();
+    for (size_t i = 0; i < ops.size(); ++i)
+        opSlots.emplace(ops[i]->getGuid(), i);
+    for (size_t i = 0; i < tensors.size(); ++i)
+        tensorSlots.emplace(tensors[i]->getFuid(), i);
+    holes = 0;
+}
+
+void GraphObj::setShape(const Tensor &tensor, const Shape &dims) {
+    IT_ASSERT(hasTensor(tensor));
+    if (tensor->getDims() == dims)
+        return;
+    tensor->setShape(dims);
+    shapeChanged.emplace_back(tensor);
+    invalidatePlan();
+}
+
+vector<Shape> GraphObj::inferShapeOf(const Operator &op) {
+    auto &memo = shapeMemo[op->getGuid()];
+    auto attrs = op->getOpAttrVector();
+    if (memo.attrs != attrs || memo.outputs.size() >= maxShapeMemo)
+        memo = {std::move(attrs), {}};
+    vector<Shape> key;
+    for (auto &input : op->getInputs())
+        key.emplace_back(input->getDims());
+    auto it = memo.outputs.find(key);
+    if (it == memo.outputs.end()) {
         auto ans = op->inferShape();
         IT_ASSERT(ans.has_value());
-        auto oldOutputs = op->getOutputs();
-        IT_ASSERT(ans.value().size() == oldOutputs.size());
-        // replace the old outputshape and size with new one
-        for (int i = 0; i < (int)ans.value().size(); ++i) {
-            auto newShape = ans.value()[i];
-            auto oldShape = oldOutputs[i]->getDims();
-            auto fuid = oldOutputs[i]->getFuid();
-            if (newShape != oldShape) {
-                auto tensor = this->getTensor(fuid);
-                tensor->setShape(newShape);
+        IT_ASSERT(ans->size() == op->getOutputs().size());
+        it = memo.outputs.emplace(std::move(key), std::move(*ans)).first;
+    }
+    return it->second;
+}
+
+void GraphObj::shape_infer() {
+    IT_ASSERT(topo_sort() == true);
+    // 按拓扑序（即 ops 中的位置）处理待推导的算子，每个至多一次
+    std::priority_queue<size_t, vector<size_t>, std::greater<size_t>> pending;
+    vector<bool> queued(ops.size(), false);
+    auto enqueueReaders = [&](const Tensor &t) {
+        for (auto &reader : t->getTargets()) {
+            size_t i = opSlots.at(reader->getGuid());
+            if (!queued[i]) {
+                queued[i] = true;
+                pending.push(i);
             }
         }
+    };
+    if (shapeChanged.empty()) {
+        for (size_t i = 0; i < ops.size(); ++i) {
+            queued[i] = true;
+            pending.push(i);
+        }
     }
-}
+    for (auto &t : shapeChanged)
+        if (hasTensor(t))
+            enqueueReaders(t);
+    shapeChanged.clear();
 
+    while (!pending.empty()) {
+        auto op = ops[pending.top()];
+        pending.pop();
+        auto shapes = inferShapeOf(op);
+        // 只有输出形状改变时才继续向后传播
+        for (size_t i = 0; i < shapes.size(); ++i) {
+            auto output = op->getOutput(i);
+            if (shapes[i] == output->getDims())
+                continue;
+            output->setShape(shapes[i]);
+            invalidatePlan();
+            enqueueReaders(output);
+        }
+    }
+}
 
 void GraphObj::dataMalloc() {
     // 首先进行拓扑排序
     IT_ASSERT(topo_sort() == true);
+    stashPlan();
+    invalidatePlan();
+    allocator.reset();
+
+    // Replay the execution order against the allocator: a tensor is allocated
+    // when its producer runs and released after its last consumer, so memory
+    // of dead intermediates is recycled. Graph inputs and outputs stay live
+    // for the whole run. Constants keep storage of their own.
+    //
+    // Tensors refer to storages, possibly at an offset, and a storage is freed
+    // with its last live tensor. Two kinds of sharing exist:
+    // - an operator that supports it writes its output in place into an input
+    //   that dies at this operator and is the only tensor left in its storage;
+    // - inputs of a Concat whose dims before the axis are all 1 are contiguous
+    //   slices of the output, so they are produced directly inside it and the
+    //   Concat itself copies nothing.
+    struct Storage {
+        size_t offset, bytes;
+        int live;
+    };
+    vector<Storage> storages;
+    std::unordered_map<TensorObj *, size_t> storageOf, offsetOf, pendingUses;
+    // tensor -> (enclosing tensor, byte offset in it) for zero-copy Concat
+    std::unordered_map<TensorObj *, pair<Tensor, size_t>> viewOf;
+    auto distinctInputs = [](const Operator &op) {
+        TensorVec ret;
+        for (auto &input : op->getInputs())
+            if (std::find(ret.begin(), ret.end(), input) == ret.end())
+                ret.emplace_back(input);
+        return ret;
+    };
+    auto allocStorage = [&](const Tensor &tensor) {
+        storageOf[tensor.get()] = storages.size();
+        offsetOf[tensor.get()] = 0;
+        storages.push_back(
+            {allocator.alloc(tensor->getBytes()), tensor->getBytes(), 1});
+    };
+    auto share = [&](const Tensor &tensor, TensorObj *owner, size_t offset) {
+        auto id = storageOf[tensor.get()] = storageOf.at(owner);
+        offsetOf[tensor.get()] = offsetOf.at(owner) + offset;
+        ++storages[id].live;
+    };
+
+    // Marked outputs are read after the run, so they never die.
+    for (auto &output : outputs)
+        ++pendingUses[output.get()];
+    for (auto &op : ops) {
+        for (auto &input : distinctInputs(op))
+            ++pendingUses[input.get()];
+        if (op->getOpType() != OpType::Concat)
+            continue;
+        auto concat = as<ConcatObj>(op);
+        auto output = concat->getOutput();
+        auto dims = output->getDims();
+        if (!std::all_of(dims.begin(), dims.begin() + concat->getDim(),
+                         [](auto d) { return d == 1; }))
+            continue;
+        size_t offset = 0;
+        const auto &inputs = concat->getInputs();
+        for (auto &input : inputs) {
+            if (input->getSource() && !viewOf.count(input.get()) &&
+                std::count(inputs.begin(), inputs.end(), input) == 1)
+                viewOf.emplace(input.get(), pair{output, offset});
+            offset += input->getBytes();
+        }
+    }
+
+    size_t naiveSize = 0;
+    for (auto &tensor : tensors) {
+        if (tensor->isConstant())
+            continue;
+        naiveSize += tensor->getBytes();
+        if (!tensor->getSource())
+            allocStorage(tensor);
+    }
+    // Ordering edges that make the plan safe for out-of-order execution,
+    // see getDependencies().
+    std::unordered_map<OperatorObj *, size_t> position;
+    for (size_t i = 0; i < ops.size(); ++i)
+        position.emplace(ops[i].get(), i);
+    auto edges = dataEdges;
+
+    for (auto &op : ops) {
+        TensorVec dying;
+        for (auto &input : distinctInputs(op))
+            if (--pendingUses[input.get()] == 0 && input->getSource())
+                dying.emplace_back(input);
+
+        op->inplaceInput = -1;
+        auto output = op->numOutputs() == 1 ? op->getOutput() : nullptr;
+        for (int i = 0; output && op->supportsInplace() &&
+                        !viewOf.count(output.get()) &&
+                        i < (int)op->getInputs().size();
+             ++i) {
+            auto input = op->getInputs(i);
+            if (std::find(dying.begin(), dying.end(), input) != dying.end() &&
+                storages[storageOf[input.get()]].live == 1 &&
+                input->getDims() == output->getDims() &&
+                input->getDType() == output->getDType()) {
+                op->inplaceInput = i;
+                share(output, input.get(), 0);
+                // Other readers of the input must finish before it is
+                // overwritten.
+                for (auto &reader : input->getTargets())
+                    if (reader != op)
+                        edges.emplace_back(position.at(reader.get()),
+                                           position.at(op.get()));
+                break;
+            }
+        }
+        for (auto &output : op->getOutputs()) {
+            if (storageOf.count(output.get()))
+                continue;
+            auto it = viewOf.find(output.get());
+            if (it == viewOf.end()) {
+                allocStorage(output);
+                continue;
+            }
+            // Place the tensor inside the outermost enclosing Concat output,
+            // which is allocated by the first of its inputs to be produced.
+            auto [root, offset] = it->second;
+            for (auto r = viewOf.find(root.get()); r != viewOf.end();
+                 r = viewOf.find(root.get())) {
+                offset += r->second.second;
+                root = r->second.first;
+            }
+            if (!storageOf.count(root.get()))
+                allocStorage(root);
+            share(output, root.get(), offset);
+        }
+        for (auto &input : dying) {
+            auto &storage = storages[storageOf[input.get()]];
+            if (--storage.live == 0)
+                allocator.free(storage.offset, storage.bytes);
+        }
+    }
 
-    // 判断是否需要先为所有张量预分配总内存
-    size_t totalSize = 0;
-    for(auto &tensor : tensors){
-        totalSize += tensor->getBytes();  // 计算总所需内存
+    // A storage placed over (parts of) dead ones is written only after every
+    // op that touched them. Storages were created in execution order, so
+    // sweeping them keeps the latest occupant of every byte range.
+    vector<vector<size_t>> users(storages.size()), writers(storages.size());
+    for (size_t i = 0; i < ops.size(); ++i) {
+        for (auto &input : ops[i]->getInputs())
+            if (!input->isConstant())
+                users[storageOf.at(input.get())].emplace_back(i);
+        for (auto &output : ops[i]->getOutputs()) {
+            users[storageOf.at(output.get())].emplace_back(i);
+            writers[storageOf.at(output.get())].emplace_back(i);
+        }
     }
-    auto basePtr = this->allocator.alloc(totalSize);  // 一次性分配总内存
-    auto hptr = this->allocator.getPtr();  // 获取已分配内存的起始指针
+    std::map<size_t, pair<size_t, size_t>> occupied; // begin -> (end, id)
+    for (size_t id = 0; id < storages.size(); ++id) {
+        size_t begin = storages[id].offset, end = begin + storages[id].bytes;
+        if (begin == end)
+            continue;
+        auto it = occupied.lower_bound(begin);
+        if (it != occupied.begin() && std::prev(it)->second.first > begin)
+            --it;
+        vector<size_t> previous;
+        while (it != occupied.end() && it->first < end) {
+            auto [oldBegin, entry] = *it;
+            auto [oldEnd, oldId] = entry;
+            previous.emplace_back(oldId);
+            it = occupied.erase(it);
+            if (oldBegin < begin)
+                occupied.emplace(oldBegin, pair{begin, oldId});
+            if (oldEnd > end)
+                occupied.emplace(end, pair{oldEnd, oldId});
+        }
+        occupied.emplace(begin, pair{end, id});
+        std::sort(previous.begin(), previous.end());
+        previous.erase(std::unique(previous.begin(), previous.end()),
+                       previous.end());
+        for (auto oldId : previous)
+            for (auto u : users[oldId])
+                for (auto w : writers[id]) {
+                    IT_ASSERT(u < w);
+                    edges.emplace_back(u, w);
+                }
+    }
+    auto entry = describePlan();
+    for (auto &tensor : tensors)
+        if (!tensor->isConstant())
+            entry.offsets.emplace_back(storages[storageOf.at(tensor.get())]
+                                           .offset +
+                                       offsetOf.at(tensor.get()));
+    for (auto &op : ops)
+        entry.inplaceInputs.emplace_back(op->inplaceInput);
+    entry.dependencies = buildDependencies(ops.size(), std::move(edges));
+    entry.peak = allocator.getPeak();
+    entry.naive = naiveSize;
 
-    // 确保内存已成功分配
-    IT_ASSERT(hptr != nullptr);
+    // 更大的缓冲区会重新分配，此前编译的执行计划随之失效
+    const size_t capacity = allocator.getCapacity();
+    IT_ASSERT(allocator.getPtr() != nullptr);
+    if (allocator.getCapacity() != capacity)
+        for (auto &other : memoryPlans)
+            other.plan = {};
+    // Plans of another graph structure can never be used again.
+    memoryPlans.erase(std::remove_if(memoryPlans.begin(), memoryPlans.end(),
+                                     [&](const MemoryPlan &other) {
+                                         return !samePlan(other, entry) ||
+                                                other.inputShapes ==
+                                                    entry.inputShapes;
+                                     }),
+                      memoryPlans.end());
+    if (memoryPlans.size() == maxMemoryPlans)
+        memoryPlans.erase(memoryPlans.begin());
+    memoryPlans.emplace_back(std::move(entry));
+    bindPlan(memoryPlans.size() - 1);
+}
 
-    // 为每个 tensor 分配内存
-    size_t currentOffset = 0;
-    for(auto &tensor : tensors){
-        auto size = tensor->getBytes();
-        auto blob = make_ref<BlobObj>(this->runtime, static_cast<char*>(hptr) + currentOffset);
-        tensor->setDataBlob(blob);
-        currentOffset += size;  // 更新偏移量
+GraphObj::MemoryPlan GraphObj::describePlan() const {
+    MemoryPlan ret;
+    for (auto &tensor : tensors) {
+        if (tensor->isConstant())
+            continue;
+        ret.tensorFuids.emplace_back(tensor->getFuid());
+        if (!tensor->getSource())
+            ret.inputShapes.emplace_back(tensor->getDims());
     }
+    for (auto &op : ops)
+        ret.opGuids.emplace_back(op->getGuid());
+    for (auto &output : outputs)
+        ret.outputFuids.emplace_back(output->getFuid());
+    return ret;
+}
 
-    // 输出内存分配信息
-    allocator.info();
+bool GraphObj::samePlan(const MemoryPlan &a, const MemoryPlan &b) {
+    return a.opGuids == b.opGuids && a.tensorFuids == b.tensorFuids &&
+           a.outputFuids == b.outputFuids;
 }
 
+void GraphObj::stashPlan() {
+    if (currentPlan < memoryPlans.size())
+        memoryPlans[currentPlan].plan = std::move(plan);
+    currentPlan = memoryPlans.size();
+}
 
+void GraphObj::bindPlan(size_t index) {
+    auto &entry = memoryPlans[index];
+    auto hptr = static_cast<char *>(allocator.getPtr());
+    auto offset = entry.offsets.begin();
+    for (auto &tensor : tensors)
+        if (!tensor->isConstant())
+            tensor->setDataBlob(make_ref<BlobObj>(runtime, hptr + *offset++));
+    for (size_t i = 0; i < ops.size(); ++i)
+        ops[i]->inplaceInput = entry.inplaceInputs[i];
+    dependencies = entry.dependencies;
+    memoryPeak = entry.peak;
+    memoryNaive = entry.naive;
+    plan = std::move(entry.plan);
+    currentPlan = index;
+}
+
+void GraphObj::reshape(const vector<pair<Tensor, Shape>> &inputShapes) {
+    stashPlan();
+    for (auto &[input, dims] : inputShapes) {
+        IT_ASSERT(!input->getSource(), "Only graph inputs can be reshaped");
+        setShape(input, dims);
+    }
+    shape_infer();
+    auto wanted = describePlan();
+    for (size_t i = 0; i < memoryPlans.size(); ++i)
+        if (memoryPlans[i].inputShapes == wanted.inputShapes &&
+            samePlan(memoryPlans[i], wanted)) {
+            bindPlan(i);
+            return;
+        }
+    dataMalloc();
+}
+
+int GraphObj::bucketOf(int n) {
+    int ret = 1;
+    while (ret < n)
+        ret *= 2;
+    return ret;
+}
 
 Tensor GraphObj::addTensor(Shape dim, DataType dtype) {
-    return tensors.emplace_back(make_ref<TensorObj>(dim, dtype, runtime));
+    return addTensor(make_ref<TensorObj>(dim, dtype, runtime));
 }
 
 Tensor GraphObj::addTensor(const Tensor &tensor) {
@@ -296,6 +1222,7 @@ Tensor GraphObj::addTensor(const Tensor &tensor) {
               std::string("Tensor runtime mismatch: cannot add a tenosr in ") +
                   tensor->getRuntime()->toString() + " to " +
                   runtime->toString());
+    tensorSlots[tensor->getFuid()] = tensors.size();
     tensors.emplace_back(tensor);
     return tensor;
 }
@@ -306,6 +1233,13 @@ TensorVec GraphObj::addTensor(const TensorVec &tensors) {
     return tensors;
 }
 
+void GraphObj::setOutputs(const TensorVec &outputs) {
+    for (auto &t : outputs)
+        IT_ASSERT(hasTensor(t), "Output is not a tensor of the graph");
+    this->outputs = outputs;
+    invalidatePlan();
+}
+
 // tensor's "source" and "target" must be in "ops".
 // tensor has no "source" and no "target" must not exist.
 // "inputs" or "outputs" of operators must be in "tensors"
@@ -315,25 +1249,23 @@ bool GraphObj::checkValid() const {
         IT_ASSERT(!(tensor->getTargets().size() == 0 &&
                     nullptr == tensor->getSource()));
         for (auto op : tensor->getTargets()) {
-            IT_ASSERT(std::find(ops.begin(), ops.end(), op) != ops.end());
+            IT_ASSERT(hasOperator(op));
         }
         auto op = tensor->getSource();
-        IT_ASSERT(!(op && std::find(ops.begin(), ops.end(), op) == ops.end()));
+        IT_ASSERT(!(op && !hasOperator(op)));
     }
     for (auto op : ops) {
         for (auto tensor : op->getInputs()) {
-            IT_ASSERT(std::find(tensors.begin(), tensors.end(), tensor) !=
-                      tensors.end());
+            IT_ASSERT(hasTensor(tensor));
         }
         for (auto tensor : op->getOutputs()) {
-            IT_ASSERT(std::find(tensors.begin(), tensors.end(), tensor) !=
-                      tensors.end());
+            IT_ASSERT(hasTensor(tensor));
         }
         for (auto pre : op->getPredecessors()) {
-            IT_ASSERT(std::find(ops.begin(), ops.end(), pre) != ops.end());
+            IT_ASSERT(hasOperator(pre));
         }
         for (auto suc : op->getSuccessors()) {
-            IT_ASSERT(std::find(ops.begin(), ops.end(), suc) != ops.end());
+            IT_ASSERT(hasOperator(suc));
         }
     }
     std::set<UidBaseType> s;
@@ -40,6 +40,30 @@ namespace infini
         }
     }
 
+    size_t OperatorObj::hash() const
+    {
+        size_t ret = type.underlying();
+        auto combine = [&](size_t v)
+        { ret ^= v + 0x9e3779b97f4a7c15 + (ret << 6) + (ret >> 2); };
+        for (auto attr : getOpAttrVector())
+            combine(std::hash<int>()(attr));
+        for (auto &input : inputs)
+            combine(std::hash<TensorObj *>()(input.get()));
+        return ret;
+    }
+
+    bool OperatorObj::isEquivalent(const OperatorObj &other) const
+    {
+        if (type != other.type || inputs != other.inputs ||
+            outputs.size() != other.outputs.size() ||
+            getOpAttrVector() != other.getOpAttrVector())
+            return false;
+        for (size_t i = 0; i < outputs.size(); ++i)
+            if (!(outputs[i]->getDType() == other.outputs[i]->getDType()))
+                return false;
+        return true;
+    }
+
     bool OperatorObj::checkValid(GraphObj *graph)
     {
         auto optShapes = inferShape();
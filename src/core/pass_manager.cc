@@ -0,0 +1,68 @@
+#include "core/pass_manager.h"
+#include "core/graph.h"
+#include <chrono>
+#include <iomanip>
+
+namespace infini
+{
+    void PassManager::addPass(string name, Pass pass)
+    {
+        passes.push_back({std::move(name), std::move(pass), {}});
+    }
+
+    void PassManager::addRewrites(string name, vector<RewriteRule> rules)
+    {
+        passes.push_back({std::move(name), nullptr, std::move(rules)});
+    }
+
+    const vector<PassStats> &PassManager::run(GraphObj &graph)
+    {
+        stats.clear();
+        for (auto &entry : passes)
+        {
+            PassStats s;
+            s.name = entry.name;
+            s.opsBefore = graph.getOperators().size();
+            auto begin = std::chrono::steady_clock::now();
+            if (entry.pass)
+                s.rewrites = entry.pass(graph);
+            else
+            {
+                auto counts = graph.applyRewrites(entry.rules);
+                for (size_t i = 0; i < entry.rules.size(); ++i)
+                {
+                    s.rules.emplace_back(entry.rules[i].name, counts[i]);
+                    s.rewrites += counts[i];
+                }
+            }
+            s.seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - begin)
+                            .count();
+            s.opsAfter = graph.getOperators().size();
+            stats.emplace_back(std::move(s));
+        }
+        return stats;
+    }
+
+    string PassManager::report(const vector<PassStats> &stats)
+    {
+        std::ostringstream os;
+        os << std::left << std::setw(24) << "Pass" << std::right
+           << std::setw(10) << "Rewrites" << std::setw(10) << "Ops"
+           << std::setw(12) << "Time(us)" << "\n";
+        for (const auto &s : stats)
+        {
+            os << std::left << std::setw(24) << s.name << std::right
+               << std::setw(10) << s.rewrites << std::setw(10)
+               << std::to_string(s.opsBefore) + "->" +
+                      std::to_string(s.opsAfter)
+               << std::setw(12) << std::fixed << std::setprecision(1)
+               << s.seconds * 1e6 << "\n";
+            for (const auto &[rule, count] : s.rules)
+                os << std::left << std::setw(24) << "  " + rule << std::right
+                   << std::setw(10) << count << "\n";
+        }
+        return os.str();
+    }
+
+} // namespace infini
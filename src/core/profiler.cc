@@ -0,0 +1,199 @@
+#include "core/profiler.h"
+#include "core/kernel.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+namespace infini
+{
+    namespace
+    {
+        double microseconds(Profiler::Clock::duration d)
+        {
+            return std::chrono::duration<double, std::micro>(d).count();
+        }
+
+        string jsonString(const string &s)
+        {
+            string out = "\"";
+            for (char c : s)
+            {
+                if (c == '"' || c == '\\')
+                    out += '\\';
+                out += c;
+            }
+            return out + "\"";
+        }
+
+        void sortByTotal(vector<Profiler::Record> &records)
+        {
+            std::stable_sort(records.begin(), records.end(),
+                             [](const auto &a, const auto &b)
+                             { return a.totalUs > b.totalUs; });
+        }
+
+        void printTable(std::ostream &os, const string &title,
+                        const vector<Profiler::Record> &records,
+                        double totalUs)
+        {
+            os << title << "\n"
+               << std::left << std::setw(24) << "Name" << std::setw(24)
+               << "Kernel" << std::right << std::setw(8) << "Calls"
+               << std::setw(12) << "Total(ms)" << std::setw(12) << "Avg(us)"
+               << std::setw(12) << "Min(us)" << std::setw(8) << "%"
+               << std::setw(10) << "GB/s" << std::setw(10) << "GFLOP/s"
+               << "\n";
+            os << std::fixed;
+            for (const auto &r : records)
+                os << std::left << std::setw(24) << r.name << std::setw(24)
+                   << r.kernel << std::right << std::setw(8) << r.calls
+                   << std::setprecision(3) << std::setw(12)
+                   << r.totalUs / 1000 << std::setw(12) << r.avgUs()
+                   << std::setw(12) << r.minUs << std::setprecision(1)
+                   << std::setw(8)
+                   << (totalUs > 0 ? 100 * r.totalUs / totalUs : 0)
+                   << std::setprecision(2) << std::setw(10) << r.gbPerSec()
+                   << std::setw(10) << r.gflopsPerSec() << "\n";
+            os << std::defaultfloat;
+        }
+    } // namespace
+
+    double Profiler::Record::gbPerSec() const
+    {
+        // Bytes per microsecond are 1e6 bytes per second.
+        return totalUs > 0 ? double(bytes) * calls / totalUs / 1e3 : 0;
+    }
+
+    double Profiler::Record::gflopsPerSec() const
+    {
+        return totalUs > 0 ? double(flops) * calls / totalUs / 1e3 : 0;
+    }
+
+    void Profiler::addRun(Device device, const OpVec &ops,
+                          const vector<OpSpan> &spans)
+    {
+        IT_ASSERT(ops.size() == spans.size());
+        const auto &kernelRegistry = KernelRegistry::getInstance();
+        for (size_t i = 0; i < ops.size(); ++i)
+        {
+            const auto &op = ops[i];
+            auto [it, inserted] =
+                recordIndex.try_emplace(op->getGuid(), records.size());
+            if (inserted)
+            {
+                Record r;
+                r.type = op->getOpType();
+                r.name = string(r.type.toString()) + "_" +
+                         to_string(op->getGuid());
+                r.kernel = std::get<1>(kernelRegistry.getKernelItem(
+                    KernelAttrs{device, r.type.underlying()}));
+                for (const auto &t : op->getInputs())
+                    r.bytes += t->getBytes();
+                for (const auto &t : op->getOutputs())
+                    r.bytes += t->getBytes();
+                r.flops = op->getFlops();
+                records.emplace_back(std::move(r));
+            }
+            auto &r = records[it->second];
+            const auto &span = spans[i];
+            double us = microseconds(span.end - span.begin);
+            r.minUs = r.calls ? std::min(r.minUs, us) : us;
+            r.maxUs = std::max(r.maxUs, us);
+            r.totalUs += us;
+            ++r.calls;
+            auto thread =
+                threadIds.try_emplace(span.thread, threadIds.size()).first;
+            events.push_back({it->second, microseconds(span.begin - origin),
+                              us, thread->second});
+        }
+        ++runs;
+    }
+
+    void Profiler::clear()
+    {
+        origin = Clock::now();
+        runs = 0;
+        records.clear();
+        recordIndex.clear();
+        events.clear();
+        threadIds.clear();
+    }
+
+    vector<Profiler::Record> Profiler::getOpRecords() const
+    {
+        auto ret = records;
+        sortByTotal(ret);
+        return ret;
+    }
+
+    vector<Profiler::Record> Profiler::getTypeRecords() const
+    {
+        vector<Record> ret;
+        map<OpType, size_t> index;
+        for (const auto &r : records)
+        {
+            auto [it, inserted] = index.try_emplace(r.type, ret.size());
+            if (inserted)
+            {
+                Record t;
+                t.name = r.type.toString();
+                t.type = r.type;
+                t.kernel = r.kernel;
+                ret.emplace_back(std::move(t));
+            }
+            auto &t = ret[it->second];
+            // Weighted by calls, so that bandwidth and throughput stay the
+            // totals over the total time.
+            size_t calls = t.calls + r.calls;
+            if (calls > 0)
+            {
+                t.bytes = (t.bytes * t.calls + r.bytes * r.calls) / calls;
+                t.flops = (t.flops * t.calls + r.flops * r.calls) / calls;
+            }
+            t.minUs = t.calls ? std::min(t.minUs, r.minUs) : r.minUs;
+            t.maxUs = std::max(t.maxUs, r.maxUs);
+            t.totalUs += r.totalUs;
+            t.calls = calls;
+        }
+        sortByTotal(ret);
+        return ret;
+    }
+
+    string Profiler::report() const
+    {
+        double totalUs = 0;
+        for (const auto &r : records)
+            totalUs += r.totalUs;
+        std::ostringstream os;
+        os << "Profiled " << runs << " run(s), " << std::fixed
+           << std::setprecision(3) << totalUs / 1000
+           << " ms in operators\n\n";
+        printTable(os, "By OpType", getTypeRecords(), totalUs);
+        os << "\n";
+        printTable(os, "By operator", getOpRecords(), totalUs);
+        return os.str();
+    }
+
+    void Profiler::dumpTrace(const string &path) const
+    {
+        std::ofstream file(path);
+        IT_ASSERT(file.is_open(), "Cannot open " + path);
+        file << "{\"traceEvents\":[";
+        file << std::fixed << std::setprecision(3);
+        for (size_t i = 0; i < events.size(); ++i)
+        {
+            const auto &e = events[i];
+            const auto &r = records[e.record];
+            file << (i ? ",\n" : "\n") << "{\"name\":" << jsonString(r.name)
+                 << ",\"cat\":" << jsonString(r.type.toString())
+                 << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.thread
+                 << ",\"ts\":" << e.beginUs << ",\"dur\":" << e.durationUs
+                 << ",\"args\":{\"kernel\":" << jsonString(r.kernel)
+                 << ",\"bytes\":" << r.bytes << ",\"flops\":" << r.flops
+                 << "}}";
+        }
+        file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        IT_ASSERT(file.good(), "Failed to write " + path);
+    }
+
+} // namespace infini
@@ -0,0 +1,67 @@
+#include "core/rewrite.h"
+#include "core/graph.h"
+
+namespace infini
+{
+    int Pattern::depth() const
+    {
+        int ret = 0;
+        for (const auto &producer : inputs)
+            ret = std::max(ret, producer.depth());
+        return ret + 1;
+    }
+
+    bool Pattern::match(const Operator &op,
+                        const std::function<bool(const Tensor &)> &isOutput,
+                        OpVec &match) const
+    {
+        if (op->getOpType() != type || (predicate && !predicate(op)))
+            return false;
+        const size_t size = match.size();
+        match.emplace_back(op);
+        for (const auto &producer : inputs)
+        {
+            const int n = op->getInputs().size();
+            const int begin = std::max(producer.index, 0);
+            const int end =
+                producer.index < 0 ? n : std::min(n, producer.index + 1);
+            bool found = false;
+            for (int i = begin; !found && i < end; ++i)
+            {
+                auto source = op->getInputs(i)->getSource();
+                if (!source ||
+                    std::find(match.begin(), match.end(), source) !=
+                        match.end())
+                    continue;
+                // The producer disappears with the match, so nothing else
+                // may read what it computes.
+                bool interior = true;
+                for (auto &output : source->getOutputs())
+                {
+                    interior &= !isOutput(output);
+                    for (auto &reader : output->getTargets())
+                        interior &= reader == op;
+                }
+                found = interior && producer.match(source, isOutput, match);
+            }
+            if (!found)
+            {
+                match.resize(size);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Tensor Rewriter::addTensor(Shape dims, DataType dtype)
+    {
+        return tensors.emplace_back(graph.addTensor(dims, dtype));
+    }
+
+    Operator Rewriter::clone(const Operator &op, const TensorVec &inputs,
+                             const TensorVec &outputs)
+    {
+        return ops.emplace_back(op->clone(inputs, outputs));
+    }
+
+} // namespace infini
@@ -1,23 +1,152 @@
 #include "core/runtime.h"
 #include "core/blob.h"
-#include "core/kernel.h"
 #include "core/graph.h"
 #include "core/kernel.h"
+#include "core/profiler.h"
+#include "core/thread_pool.h"
+#include <atomic>
 #include <chrono>
 #include <cstring>
 #include <memory>
+#include <thread>
 namespace infini
 {
+    NativeCpuRuntimeObj::NativeCpuRuntimeObj() : RuntimeObj(Device::CPU)
+    {
+        setNumThreads(1);
+    }
+
+    NativeCpuRuntimeObj::~NativeCpuRuntimeObj() = default;
+
+    void NativeCpuRuntimeObj::setNumThreads(size_t interOp, size_t intraOp)
+    {
+        IT_ASSERT(interOp >= 1);
+        if (intraOp == 0)
+            intraOp = std::max<size_t>(
+                1, std::thread::hardware_concurrency() / interOp);
+        interOpThreads = interOp;
+        intraOpThreads = intraOp;
+        if (!pool || pool->getNumThreads() != interOp * intraOp)
+        {
+            pool.reset();
+            pool = std::make_unique<ThreadPool>(interOp * intraOp, true);
+        }
+    }
+
+    void NativeCpuRuntimeObj::parallelFor(
+        size_t n, size_t grain,
+        const std::function<void(size_t, size_t)> &body) const
+    {
+        pool->parallelFor(n, grain, intraOpThreads, body);
+    }
+
+    void NativeCpuRuntimeObj::setProfiling(bool enable)
+    {
+        if (enable && !profiler)
+            profiler = std::make_unique<Profiler>();
+        profiling = enable;
+    }
+
     void NativeCpuRuntimeObj::run(const Graph &graph) const
     {
-        const auto &kernelRegistry = KernelRegistry::getInstance();
+        if (interOpThreads > 1)
+            IT_ASSERT(graph->topo_sort(), "Graph has a cycle");
+        const auto &steps = compile(graph);
+        vector<OpSpan> spans(profiling ? steps.size() : 0);
+        OpSpan *timings = profiling ? spans.data() : nullptr;
+        if (interOpThreads > 1)
+            runParallel(graph, steps, timings);
+        else
+            runSerial(steps, timings);
+        if (profiling)
+            profiler->addRun(device, graph->getOperators(), spans);
+    }
 
-        for (auto &op : graph->getOperators())
+    const vector<CompiledKernel> &
+    NativeCpuRuntimeObj::compile(const Graph &graph) const
+    {
+        auto &plan = graph->getPlan();
+        const auto &ops = graph->getOperators();
+        if (plan.runtime == this && plan.steps.size() == ops.size())
+            return plan.steps;
+
+        const auto &kernelRegistry = KernelRegistry::getInstance();
+        plan.runtime = this;
+        plan.steps.clear();
+        plan.steps.reserve(ops.size());
+        for (auto &op : ops)
         {
             auto kernelAttrs = KernelAttrs{device, op->getOpType().underlying()};
             Kernel *kernel = kernelRegistry.getKernel(kernelAttrs);
-            kernel->compute(op, this);
+            plan.steps.emplace_back(kernel->compile(op, this));
         }
+        return plan.steps;
+    }
+
+    // Runs a step, recording when and where if timing is not null.
+    static void runStep(const CompiledKernel &step, OpSpan *timing)
+    {
+        if (!timing)
+        {
+            step();
+            return;
+        }
+        timing->thread = std::this_thread::get_id();
+        timing->begin = Profiler::Clock::now();
+        step();
+        timing->end = Profiler::Clock::now();
+    }
+
+    void NativeCpuRuntimeObj::runSerial(const vector<CompiledKernel> &steps,
+                                        OpSpan *timings) const
+    {
+        for (size_t i = 0; i < steps.size(); ++i)
+            runStep(steps[i], timings ? timings + i : nullptr);
+    }
+
+    void NativeCpuRuntimeObj::runParallel(const Graph &graph,
+                                          const vector<CompiledKernel> &steps,
+                                          OpSpan *timings) const
+    {
+        const auto &deps = graph->getDependencies();
+        const size_t n = steps.size();
+
+        std::unique_ptr<std::atomic<size_t>[]> pending(
+            new std::atomic<size_t>[n]);
+        for (size_t i = 0; i < n; ++i)
+            pending[i].store(deps.numPredecessors[i],
+                             std::memory_order_relaxed);
+
+        TaskGroup group(*pool);
+        // Runs op i, then goes on with one of the successors it made ready on
+        // the same thread and spawns the others.
+        std::function<void(size_t)> execute = [&](size_t i)
+        {
+            while (true)
+            {
+                runStep(steps[i], timings ? timings + i : nullptr);
+                size_t next = n;
+                for (size_t s = deps.successorOffsets[i];
+                     s < deps.successorOffsets[i + 1]; ++s)
+                {
+                    size_t succ = deps.successors[s];
+                    if (pending[succ].fetch_sub(
+                            1, std::memory_order_acq_rel) != 1)
+                        continue;
+                    if (next == n)
+                        next = succ;
+                    else
+                        group.spawn([&execute, succ] { execute(succ); });
+                }
+                if (next == n)
+                    return;
+                i = next;
+            }
+        };
+        for (size_t i = 0; i < n; ++i)
+            if (deps.numPredecessors[i] == 0)
+                group.spawn([&execute, i] { execute(i); });
+        group.wait();
     }
 
     string NativeCpuRuntimeObj::toString() const { return "CPU Runtime"; }
@@ -26,6 +26,8 @@ namespace infini {
         vector<UidBaseType> targetGuids;
         for (const auto &op : targets)
             targetGuids.emplace_back(op.lock()->getGuid());
+        if (constant)
+            ret += ", constant";
         if (auto o = source.lock())
             ret += ", source " + std::to_string(o->getGuid());
         else
@@ -113,4 +115,12 @@ void TensorObj::setData(
 
 void TensorObj::setDataBlob(const Blob &blob) { this->data = blob; }
 
+void TensorObj::setConstant() {
+    IT_ASSERT(!getSource(), "Only tensors with no source can be constants");
+    if (constant)
+        return;
+    constant = true;
+    data = make_ref<BlobObj>(runtime, getBytes());
+}
+
 }; // namespace infini
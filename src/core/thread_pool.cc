@@ -0,0 +1,251 @@
+#include "core/thread_pool.h"
+#include <utility>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace infini
+{
+    namespace
+    {
+        // Pool and queue index of the calling thread, if it is a worker.
+        thread_local const ThreadPool *currentPool = nullptr;
+        thread_local size_t currentIndex = 0;
+
+        // Failed attempts to find a task before a thread goes to sleep.
+        constexpr int SpinCount = 64;
+
+        vector<int> allowedCpus()
+        {
+            vector<int> cpus;
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0)
+                for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                    if (CPU_ISSET(cpu, &set))
+                        cpus.emplace_back(cpu);
+#endif
+            return cpus;
+        }
+
+        void pinCurrentThread(int cpu)
+        {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+        }
+    } // namespace
+
+    TaskGroup::~TaskGroup()
+    {
+        if (pending.load(std::memory_order_acquire) > 0)
+            pool.waitFor(*this);
+    }
+
+    void TaskGroup::spawn(std::function<void()> task)
+    {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        pool.push({std::move(task), this});
+    }
+
+    void TaskGroup::wait()
+    {
+        pool.waitFor(*this);
+        std::exception_ptr e;
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            e = std::exchange(error, nullptr);
+        }
+        if (e)
+            std::rethrow_exception(e);
+    }
+
+    ThreadPool::ThreadPool(size_t numThreads, bool pinThreads)
+    {
+        IT_ASSERT(numThreads >= 1);
+        for (size_t i = 0; i < numThreads; ++i)
+            queues.emplace_back(std::make_unique<Queue>());
+        auto cpus = allowedCpus();
+        bool pin = pinThreads && cpus.size() >= numThreads;
+        workers.reserve(numThreads - 1);
+        for (size_t i = 1; i < numThreads; ++i)
+            workers.emplace_back(&ThreadPool::workerLoop, this, i,
+                                 pin ? cpus[i] : -1);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    void ThreadPool::parallelFor(
+        size_t n, size_t grain, size_t maxChunks,
+        const std::function<void(size_t, size_t)> &body)
+    {
+        if (n == 0)
+            return;
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = std::min(n / grain, maxChunks);
+        if (chunks <= 1 || queues.size() == 1)
+        {
+            body(0, n);
+            return;
+        }
+        TaskGroup group(*this);
+        // Pushed last to first: this thread pops chunk 1 next while thieves
+        // take the last ones.
+        for (size_t c = chunks; c-- > 1;)
+            group.spawn([&body, n, c, chunks]
+                        { body(n * c / chunks, n * (c + 1) / chunks); });
+        std::exception_ptr e;
+        try
+        {
+            body(0, n / chunks);
+        }
+        catch (...)
+        {
+            e = std::current_exception();
+        }
+        group.wait();
+        if (e)
+            std::rethrow_exception(e);
+    }
+
+    void ThreadPool::push(Task task)
+    {
+        auto &queue = *queues[currentPool == this ? currentIndex : 0];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.emplace_back(std::move(task));
+        }
+        queued.fetch_add(1);
+        notify(false);
+    }
+
+    bool ThreadPool::runOne()
+    {
+        if (queued.load() == 0)
+            return false;
+        const size_t self = currentPool == this ? currentIndex : 0;
+        Task task{nullptr, nullptr};
+        {
+            auto &own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+            }
+        }
+        for (size_t k = 1; !task.group && k < queues.size(); ++k)
+        {
+            auto &victim = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+            }
+        }
+        if (!task.group)
+            return false;
+        queued.fetch_sub(1);
+
+        auto group = task.group;
+        try
+        {
+            task.fn();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(group->errorMutex);
+            if (!group->error)
+                group->error = std::current_exception();
+        }
+        // Captures may refer to the waiter's stack: release them first.
+        task.fn = nullptr;
+        if (group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            notify(true);
+        return true;
+    }
+
+    void ThreadPool::waitFor(TaskGroup &group)
+    {
+        for (int spins = 0;
+             group.pending.load(std::memory_order_acquire) > 0;)
+        {
+            if (runOne())
+            {
+                spins = 0;
+                continue;
+            }
+            if (++spins < SpinCount)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            ++sleepers;
+            wake.wait(lock, [&]
+                      { return queued.load() > 0 ||
+                               group.pending.load() == 0; });
+            --sleepers;
+            spins = 0;
+        }
+    }
+
+    void ThreadPool::workerLoop(size_t index, int cpu)
+    {
+        currentPool = this;
+        currentIndex = index;
+        if (cpu >= 0)
+            pinCurrentThread(cpu);
+        for (int spins = 0;;)
+        {
+            if (runOne())
+            {
+                spins = 0;
+                continue;
+            }
+            if (++spins < SpinCount)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            ++sleepers;
+            wake.wait(lock, [this]
+                      { return stopping || queued.load() > 0; });
+            --sleepers;
+            if (stopping && queued.load() == 0)
+                return;
+            spins = 0;
+        }
+    }
+
+    void ThreadPool::notify(bool all)
+    {
+        if (sleepers.load() == 0)
+            return;
+        {
+            // Orders the wake up after the sleeper checked its condition.
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        if (all)
+            wake.notify_all();
+        else
+            wake.notify_one();
+    }
+
+} // namespace infini
@@ -0,0 +1,251 @@
+#include "core/kernel.h"
+#include "operators/unary.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INFINI_CAST_X86
+#endif
+
+namespace infini {
+
+namespace {
+
+// Minimum elements per parallel chunk.
+constexpr size_t GrainSize = 1 << 14;
+
+using CastFn = void (*)(const void *src, void *dst, size_t n);
+
+template <typename Src, typename Dst>
+void castElements(const void *src, void *dst, size_t n) {
+    auto in = static_cast<const Src *>(src);
+    auto out = static_cast<Dst *>(dst);
+#pragma omp simd
+    for (size_t i = 0; i < n; ++i)
+        out[i] = static_cast<Dst>(in[i]);
+}
+
+void copyFloat(const void *src, void *dst, size_t n) {
+    if (src != dst)
+        std::memcpy(dst, src, n * sizeof(float));
+}
+
+inline uint32_t floatBits(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    return x;
+}
+
+inline float bitsFloat(uint32_t x) {
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+// IEEE binary16 with round to nearest even, as done by F16C.
+inline uint16_t floatToHalf(float f) {
+    uint32_t x = floatBits(f);
+    uint16_t sign = (x >> 16) & 0x8000;
+    uint32_t abs = x & 0x7FFFFFFF;
+    if (abs > 0x7F800000) // NaN, kept quiet
+        return sign | 0x7E00 | ((abs >> 13) & 0x3FF);
+    if (abs >= 0x47800000) // >= 65536 (or inf) overflows
+        return sign | 0x7C00;
+    if (abs < 0x38800000) // below 2^-14: subnormal, rounded by the FPU
+        return sign | static_cast<uint16_t>(
+                          std::nearbyint(bitsFloat(abs) * 16777216.f));
+    uint32_t h = ((abs >> 23) - 112) << 10 | (abs >> 13 & 0x3FF);
+    uint32_t rest = abs & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+        ++h; // may carry into the exponent, up to inf
+    return sign | h;
+}
+
+inline float halfToFloat(uint16_t h) {
+    uint32_t sign = (h & 0x8000u) << 16;
+    uint32_t exp = h >> 10 & 0x1F, mant = h & 0x3FF;
+    if (exp == 0x1F) // inf, or NaN made quiet
+        return bitsFloat(sign | 0x7F800000 | mant << 13 |
+                         (mant ? 0x400000 : 0));
+    if (exp == 0) // subnormal or zero: mant * 2^-24
+        return bitsFloat(sign | floatBits(mant * 5.9604644775390625e-8f));
+    return bitsFloat(sign | (exp + 112) << 23 | mant << 13);
+}
+
+#ifdef INFINI_CAST_X86
+bool hasF16c() {
+    static const bool f16c = (__builtin_cpu_init(),
+                              __builtin_cpu_supports("avx") &&
+                                  __builtin_cpu_supports("f16c"));
+    return f16c;
+}
+
+__attribute__((target("avx,f16c"))) size_t
+floatToHalfF16c(const float *in, uint16_t *out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                         _mm256_cvtps_ph(_mm256_loadu_ps(in + i),
+                                         _MM_FROUND_TO_NEAREST_INT));
+    return i;
+}
+
+__attribute__((target("avx,f16c"))) size_t
+halfToFloatF16c(const uint16_t *in, float *out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i,
+                         _mm256_cvtph_ps(_mm_loadu_si128(
+                             reinterpret_cast<const __m128i *>(in + i))));
+    return i;
+}
+#endif
+
+void castFloatToHalf(const void *src, void *dst, size_t n) {
+    auto in = static_cast<const float *>(src);
+    auto out = static_cast<uint16_t *>(dst);
+    size_t i = 0;
+#ifdef INFINI_CAST_X86
+    if (hasF16c())
+        i = floatToHalfF16c(in, out, n);
+#endif
+    for (; i < n; ++i)
+        out[i] = floatToHalf(in[i]);
+}
+
+void castHalfToFloat(const void *src, void *dst, size_t n) {
+    auto in = static_cast<const uint16_t *>(src);
+    auto out = static_cast<float *>(dst);
+    size_t i = 0;
+#ifdef INFINI_CAST_X86
+    if (hasF16c())
+        i = halfToFloatF16c(in, out, n);
+#endif
+    for (; i < n; ++i)
+        out[i] = halfToFloat(in[i]);
+}
+
+// bfloat16 is the upper half of a float, rounded to nearest even. Both loops
+// are branch free so that they vectorize.
+void castFloatToBFloat16(const void *src, void *dst, size_t n) {
+    auto in = static_cast<const uint32_t *>(src);
+    auto out = static_cast<uint16_t *>(dst);
+#pragma omp simd
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t x = in[i];
+        uint32_t rounded = (x + 0x7FFF + (x >> 16 & 1)) >> 16;
+        uint32_t nan = x >> 16 | 0x40;
+        out[i] = (x & 0x7FFFFFFF) > 0x7F800000 ? nan : rounded;
+    }
+}
+
+void castBFloat16ToFloat(const void *src, void *dst, size_t n) {
+    auto in = static_cast<const uint16_t *>(src);
+    auto out = static_cast<uint32_t *>(dst);
+#pragma omp simd
+    for (size_t i = 0; i < n; ++i)
+        out[i] = static_cast<uint32_t>(in[i]) << 16;
+}
+
+struct CastEntry {
+    CastType type;
+    DataType src, dst;
+    CastFn fn;
+};
+
+// Indexed by CastType.
+const vector<CastEntry> &castTable() {
+    static const vector<CastEntry> table{
+        {CastType::Float2Float16, DataType::Float32, DataType::Float16,
+         castFloatToHalf},
+        {CastType::Float2Int64, DataType::Float32, DataType::Int64,
+         castElements<float, int64_t>},
+        {CastType::Float2Int32, DataType::Float32, DataType::Int32,
+         castElements<float, int32_t>},
+        {CastType::Float2Int16, DataType::Float32, DataType::Int16,
+         castElements<float, int16_t>},
+        {CastType::Float2Int8, DataType::Float32, DataType::Int8,
+         castElements<float, int8_t>},
+        {CastType::Float2BFloat16, DataType::Float32, DataType::BFloat16,
+         castFloatToBFloat16},
+        {CastType::Int322Float, DataType::Int32, DataType::Float32,
+         castElements<int32_t, float>},
+        {CastType::Int322Int8, DataType::Int32, DataType::Int8,
+         castElements<int32_t, int8_t>},
+        {CastType::Int322Int16, DataType::Int32, DataType::Int16,
+         castElements<int32_t, int16_t>},
+        {CastType::Int322Int64, DataType::Int32, DataType::Int64,
+         castElements<int32_t, int64_t>},
+        {CastType::Int162Float, DataType::Int16, DataType::Float32,
+         castElements<int16_t, float>},
+        {CastType::Int162Int32, DataType::Int16, DataType::Int32,
+         castElements<int16_t, int32_t>},
+        {CastType::Int82Float, DataType::Int8, DataType::Float32,
+         castElements<int8_t, float>},
+        {CastType::Int82Int16, DataType::Int8, DataType::Int16,
+         castElements<int8_t, int16_t>},
+        {CastType::Int82Int32, DataType::Int8, DataType::Int32,
+         castElements<int8_t, int32_t>},
+        {CastType::Uint82Float, DataType::UInt8, DataType::Float32,
+         castElements<uint8_t, float>},
+        {CastType::Uint82Int32, DataType::UInt8, DataType::Int32,
+         castElements<uint8_t, int32_t>},
+        {CastType::Uint82Int64, DataType::UInt8, DataType::Int64,
+         castElements<uint8_t, int64_t>},
+        {CastType::Int642Int32, DataType::Int64, DataType::Int32,
+         castElements<int64_t, int32_t>},
+        {CastType::Int642Uint32, DataType::Int64, DataType::UInt32,
+         castElements<int64_t, uint32_t>},
+        {CastType::Int642Float, DataType::Int64, DataType::Float32,
+         castElements<int64_t, float>},
+        {CastType::Uint322Int64, DataType::UInt32, DataType::Int64,
+         castElements<uint32_t, int64_t>},
+        {CastType::Float162Float, DataType::Float16, DataType::Float32,
+         castHalfToFloat},
+        {CastType::BFloat162Float, DataType::BFloat16, DataType::Float32,
+         castBFloat16ToFloat},
+        {CastType::Float2Float, DataType::Float32, DataType::Float32,
+         copyFloat},
+    };
+    return table;
+}
+
+} // namespace
+
+class NativeCast : public CpuKernelWithoutConfig {
+    CompiledKernel compile(const Operator &_op,
+                           const RuntimeObj *context) const override {
+        auto op = as<CastObj>(_op);
+        auto castType = op->getType();
+        const auto &table = castTable();
+        auto index = static_cast<size_t>(enum_to_underlying(castType));
+        IT_ASSERT(index < table.size() && table[index].type == castType);
+        const auto &entry = table[index];
+        auto input = op->getInputs(0), output = op->getOutput();
+        IT_ASSERT(input->getDType() == entry.src,
+                  "Cast input is " + input->getDType().toString() +
+                      ", expected " + entry.src.toString());
+        IT_ASSERT(output->getDType() == entry.dst);
+
+        auto src = input->getRawDataPtr<const char *>();
+        auto dst = output->getRawDataPtr<char *>();
+        const size_t n = input->size(), srcSize = entry.src.getSize(),
+                     dstSize = entry.dst.getSize();
+        auto fn = entry.fn;
+        return [=] {
+            context->parallelFor(n, GrainSize, [&](size_t begin, size_t end) {
+                fn(src + begin * srcSize, dst + begin * dstSize, end - begin);
+            });
+        };
+    }
+
+    void compute(const Operator &_op,
+                 const RuntimeObj *context) const override {
+        compile(_op, context)();
+    }
+};
+
+REGISTER_KERNEL(Device::CPU, OpType::Cast, NativeCast, "Cast_CPU");
+
+} // namespace infini
@@ -1,64 +1,87 @@
 #include "operators/concat.h"
 #include "core/kernel.h"
+#include <cstring>
 
 namespace infini {
 
-class NaiveConcat : public CpuKernelWithoutConfig {
+class NativeConcat : public CpuKernelWithoutConfig {
+    // Minimum elements per parallel chunk.
+    static constexpr size_t GrainSize = 1 << 14;
+
     template <typename T>
-    void doCompute(const Operator &_op, const RuntimeObj *context) const {
+    CompiledKernel doCompile(const Operator &_op,
+                             const RuntimeObj *context) const {
         auto op = as<ConcatObj>(_op);
-        auto inputs = op->getInputs(), outputs = op->getOutputs();
+        auto inputs = op->getInputs();
         auto dim = op->getDim();
-        auto output = outputs[0];
-        std::vector<Shape> iDims;
-        for (auto input : inputs)
-            iDims.emplace_back(input->getDims());
+        auto output = op->getOutput();
         const auto &outDim = output->getDims();
-        size_t blockOffsetInner = 1;
-        for (size_t i = outDim.size() - 1; i > (size_t)dim; --i)
+        size_t blockOffsetInner = 1, outer = 1;
+        for (size_t i = dim + 1; i < outDim.size(); ++i)
             blockOffsetInner *= outDim[i];
+        for (int i = 0; i < dim; ++i)
+            outer *= outDim[i];
         size_t blockOffset = outDim[dim] * blockOffsetInner;
-        for (size_t i = 0; i < inputs.size(); ++i) {
-            auto input = inputs[i];
-            auto dimOffset = 0;
-            auto iDim = iDims[i];
-            for (size_t j = 0; j < i; ++j)
-                dimOffset += iDims[j][dim];
-            size_t localBlockOffset = 1;
-            for (size_t i = iDim.size() - 1;
-                 i >= (size_t)dim && i != (size_t)-1; --i)
-                localBlockOffset *= iDim[i];
-            auto innerOffset = blockOffsetInner * dimOffset;
-            auto inSize = input->size();
-            auto inPtr = input->getRawDataPtr<T *>(),
-                 outPtr = output->getRawDataPtr<T *>();
-#pragma omp parallel for
-            for (size_t iOffset = 0; iOffset < inSize; ++iOffset) {
-                auto oOffset = iOffset % localBlockOffset + innerOffset +
-                               iOffset / localBlockOffset * blockOffset;
-                outPtr[oOffset] = inPtr[iOffset];
-            }
+
+        // For every outer index, each input contributes one contiguous run of
+        // localBlockOffset elements. Inputs that memory planning already
+        // placed at their final position (zero-copy concat) are skipped.
+        struct Block {
+            const T *src;
+            size_t offset, size;
+        };
+        vector<Block> blocks;
+        auto outPtr = output->getRawDataPtr<T *>();
+        size_t innerOffset = 0;
+        for (auto &input : inputs) {
+            size_t localBlockOffset = input->getDims()[dim] * blockOffsetInner;
+            auto inPtr = input->getRawDataPtr<T *>();
+            if (outer != 1 || inPtr != outPtr + innerOffset)
+                blocks.push_back({inPtr, innerOffset, localBlockOffset});
+            innerOffset += localBlockOffset;
         }
+
+        const size_t nBlocks = blocks.size(), copies = outer * nBlocks;
+        if (copies == 0)
+            return [] {};
+        const size_t copySize = std::max<size_t>(1, output->size() / copies);
+        return [=, blocks = std::move(blocks)] {
+            context->parallelFor(
+                copies, (GrainSize + copySize - 1) / copySize,
+                [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; ++i) {
+                        size_t o = i / nBlocks;
+                        const auto &block = blocks[i % nBlocks];
+                        std::memcpy(outPtr + o * blockOffset + block.offset,
+                                    block.src + o * block.size,
+                                    block.size * sizeof(T));
+                    }
+                });
+        };
     }
 
-    void compute(const Operator &_op,
-                 const RuntimeObj *context) const override {
+    CompiledKernel compile(const Operator &_op,
+                           const RuntimeObj *context) const override {
 #define CASE(N)                                                                \
     case N:                                                                    \
-        doCompute<DT<N>::t>(_op, context)
+        return doCompile<DT<N>::t>(_op, context)
 
         int dataTypeIdx = _op->getDType().getIndex();
         switch (dataTypeIdx) {
             CASE(1); // DataType::Float32
-            break;
             CASE(12); // DataType::UInt32
-            break;
         default:
             IT_TODO_HALT();
         }
+        return nullptr;
+    }
+
+    void compute(const Operator &_op,
+                 const RuntimeObj *context) const override {
+        compile(_op, context)();
     }
 };
 
-REGISTER_KERNEL(Device::CPU, OpType::Concat, NaiveConcat, "ConcatNaive_CPU");
+REGISTER_KERNEL(Device::CPU, OpType::Concat, NativeConcat, "Concat_CPU");
 
 } // namespace infini
@@ -6,109 +6,214 @@ namespace infini
 {
     class NativeElementWise : public CpuKernelWithoutConfig
     {
-        template <typename T>
-        static T addCompute(T val0, T val1)
+        // Elements per unit of work; large rows are split into such blocks.
+        static constexpr size_t BlockSize = 4096;
+        // Minimum elements per parallel chunk.
+        static constexpr size_t GrainSize = 1 << 14;
+
+        /**
+         * @brief Output dims with the element strides of both inputs (0 on
+         * broadcast dims). Unit dims are dropped and adjacent dims that are
+         * broadcast the same way for both inputs are merged, so e.g. equal
+         * shapes collapse to one dim and a bias add to two.
+         */
+        struct BroadcastLayout
+        {
+            Shape dims;
+            vector<size_t> strideA, strideB;
+        };
+
+        static BroadcastLayout collapse(const Shape &shapeA, const Shape &shapeB,
+                                        const Shape &shapeC)
         {
-            return val0 + val1;
+            auto rank = shapeC.size();
+            Shape a(rank, 1), b(rank, 1);
+            std::copy(shapeA.begin(), shapeA.end(),
+                      a.begin() + (rank - shapeA.size()));
+            std::copy(shapeB.begin(), shapeB.end(),
+                      b.begin() + (rank - shapeB.size()));
+            BroadcastLayout layout;
+            vector<bool> fullA, fullB;
+            for (size_t i = 0; i < rank; ++i)
+            {
+                if (shapeC[i] == 1)
+                    continue;
+                bool fa = a[i] != 1, fb = b[i] != 1;
+                if (!layout.dims.empty() && fullA.back() == fa &&
+                    fullB.back() == fb)
+                {
+                    layout.dims.back() *= shapeC[i];
+                    continue;
+                }
+                layout.dims.emplace_back(shapeC[i]);
+                fullA.emplace_back(fa);
+                fullB.emplace_back(fb);
+            }
+            size_t n = layout.dims.size(), stepA = 1, stepB = 1;
+            layout.strideA.resize(n);
+            layout.strideB.resize(n);
+            for (size_t i = n; i-- > 0;)
+            {
+                layout.strideA[i] = fullA[i] ? stepA : 0;
+                layout.strideB[i] = fullB[i] ? stepB : 0;
+                stepA *= fullA[i] ? layout.dims[i] : 1;
+                stepB *= fullB[i] ? layout.dims[i] : 1;
+            }
+            return layout;
         }
 
-        template <typename T>
-        static T subCompute(T val0, T val1)
+        // Contiguous run of the output. Strides are 0 or 1; each combination
+        // gets its own loop so that the compiler vectorizes it. `c` may alias
+        // `a` or `b` when the op runs in place.
+        template <typename T, typename F>
+        static void innerLoop(size_t n, const T *a, size_t sa, const T *b,
+                              size_t sb, T *c, F f)
         {
-            return val0 - val1;
+            if (sa && sb)
+            {
+#pragma omp simd
+                for (size_t i = 0; i < n; ++i)
+                    c[i] = f(a[i], b[i]);
+            }
+            else if (sa)
+            {
+                const T y = *b;
+#pragma omp simd
+                for (size_t i = 0; i < n; ++i)
+                    c[i] = f(a[i], y);
+            }
+            else if (sb)
+            {
+                const T x = *a;
+#pragma omp simd
+                for (size_t i = 0; i < n; ++i)
+                    c[i] = f(x, b[i]);
+            }
+            else
+            {
+                std::fill_n(c, n, f(*a, *b));
+            }
         }
 
-        template <typename T>
-        static T mulCompute(T val0, T val1)
+        template <typename T, typename F>
+        static void broadcastLoop(const RuntimeObj *context,
+                                  const BroadcastLayout &layout, const T *a,
+                                  const T *b, T *c, size_t n, F f)
         {
-            return val0 * val1;
+            const auto &dims = layout.dims;
+            const size_t rank = dims.size();
+            const size_t inner = rank ? dims.back() : 1;
+            const size_t sa = rank ? layout.strideA.back() : 0,
+                         sb = rank ? layout.strideB.back() : 0;
+            const size_t colBlocks = (inner + BlockSize - 1) / BlockSize;
+            if (n == 0)
+                return;
+            const size_t units = n / inner * colBlocks;
+
+            const size_t unitSize = std::min(inner, BlockSize);
+            context->parallelFor(
+                units, (GrainSize + unitSize - 1) / unitSize,
+                [&](size_t u, size_t uEnd)
+            {
+                // Position of the first row by div/mod once, then stepped
+                // with incremental counters.
+                size_t row = u / colBlocks, cb = u % colBlocks;
+                size_t offA = 0, offB = 0;
+                Shape idx(rank ? rank - 1 : 0);
+                for (size_t d = idx.size(), rest = row; d-- > 0;)
+                {
+                    idx[d] = rest % dims[d];
+                    rest /= dims[d];
+                    offA += idx[d] * layout.strideA[d];
+                    offB += idx[d] * layout.strideB[d];
+                }
+                for (; u < uEnd; ++u)
+                {
+                    size_t j = cb * BlockSize;
+                    size_t len = std::min(BlockSize, inner - j);
+                    innerLoop(len, a + offA + j * sa, sa, b + offB + j * sb, sb,
+                              c + row * inner + j, f);
+                    if (++cb < colBlocks)
+                        continue;
+                    cb = 0;
+                    ++row;
+                    for (size_t d = idx.size(); d-- > 0;)
+                    {
+                        offA += layout.strideA[d];
+                        offB += layout.strideB[d];
+                        if (++idx[d] < dims[d])
+                            break;
+                        offA -= layout.strideA[d] * dims[d];
+                        offB -= layout.strideB[d] * dims[d];
+                        idx[d] = 0;
+                    }
+                }
+            });
         }
 
-        template <typename T>
-        static T divCompute(T val0, T val1)
+        template <typename T, typename F>
+        static CompiledKernel bind(const RuntimeObj *context,
+                                   const BroadcastLayout &layout, const T *a,
+                                   const T *b, T *c, size_t n, F f)
         {
-            return (T)(val0 / val1);
+            return [=] { broadcastLoop(context, layout, a, b, c, n, f); };
         }
 
         template <typename T>
-        void doCompute(const Operator &_op, const RuntimeObj *context) const
+        CompiledKernel doCompile(const Operator &_op,
+                                 const RuntimeObj *context) const
         {
             auto op = as<ElementWiseObj>(_op);
             T *inptr0 = op->getInputs(0)->getRawDataPtr<T *>();
             T *inptr1 = op->getInputs(1)->getRawDataPtr<T *>();
             T *outptr = op->getOutput()->getRawDataPtr<T *>();
 
-            auto shapeA = op->getInputs(0)->getDims();
-            auto shapeB = op->getInputs(1)->getDims();
-            auto shapeC = op->getOutput()->getDims();
-            auto rank = op->getOutput()->getRank();
-            Shape a(rank, 1);
-            Shape b(rank, 1);
-            std::copy(shapeA.begin(), shapeA.end(),
-                      a.begin() + (rank - shapeA.size()));
-            std::copy(shapeB.begin(), shapeB.end(),
-                      b.begin() + (rank - shapeB.size()));
-            auto getStride = [&](const Shape &shape)
-            {
-                int p = 1;
-                Shape stride(rank);
-                for (auto i = rank; i > 0; --i)
-                {
-                    stride[i - 1] = p;
-                    p = p * shape[i - 1];
-                }
-                return stride;
-            };
-            Shape strideA = getStride(a);
-            Shape strideB = getStride(b);
-
+            auto layout = collapse(op->getInputs(0)->getDims(),
+                                   op->getInputs(1)->getDims(),
+                                   op->getOutput()->getDims());
             auto n = op->getOutput()->size();
-            T (*_doCompute)
-            (T val0, T val1);
             switch (op->getOpType().underlying())
             {
             case OpType::Add:
-                _doCompute = addCompute<T>;
-                break;
+                return bind(context, layout, inptr0, inptr1, outptr, n,
+                            [](T x, T y) { return x + y; });
             case OpType::Sub:
-                _doCompute = subCompute<T>;
-                break;
+                return bind(context, layout, inptr0, inptr1, outptr, n,
+                            [](T x, T y) { return x - y; });
             case OpType::Mul:
-                _doCompute = mulCompute<T>;
-                break;
+                return bind(context, layout, inptr0, inptr1, outptr, n,
+                            [](T x, T y) { return x * y; });
             case OpType::Div:
-                _doCompute = divCompute<T>;
-                break;
+                return bind(context, layout, inptr0, inptr1, outptr, n,
+                            [](T x, T y) { return (T)(x / y); });
             default:
                 IT_TODO_HALT();
             }
-
-            for (size_t i = 0; i < n; ++i)
-            {
-                auto shapeIndexC = locate_index(i, shapeC);
-                auto indexA = delocate_index(shapeIndexC, a, strideA);
-                auto indexB = delocate_index(shapeIndexC, b, strideB);
-                outptr[i] = _doCompute(inptr0[indexA], inptr1[indexB]);
-            }
+            return nullptr;
         }
 
-        void compute(const Operator &_op,
-                     const RuntimeObj *context) const override
+        CompiledKernel compile(const Operator &_op,
+                               const RuntimeObj *context) const override
         {
 #define CASE(N) \
     case N:     \
-        doCompute<DT<N>::t>(_op, context)
+        return doCompile<DT<N>::t>(_op, context)
 
             int dataTypeIdx = _op->getDType().getIndex();
             switch (dataTypeIdx)
             {
                 CASE(1); // DataType::Float32
-                break;
                 CASE(12); // DataType::UInt32
-                break;
             default:
                 IT_TODO_HALT();
             }
+            return nullptr;
+        }
+
+        void compute(const Operator &_op,
+                     const RuntimeObj *context) const override
+        {
+            compile(_op, context)();
         }
     };
 
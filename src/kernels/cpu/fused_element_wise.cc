@@ -0,0 +1,307 @@
+#include "operators/fused_element_wise.h"
+#include "core/kernel.h"
+
+namespace infini
+{
+    class NativeFusedElementWise : public CpuKernelWithoutConfig
+    {
+        // Elements evaluated at once; every stack level gets a buffer of
+        // this size, small enough for all of them to stay in L1.
+        static constexpr size_t BlockSize = 1024;
+        // Minimum elements per parallel chunk.
+        static constexpr size_t GrainSize = 1 << 14;
+
+        /**
+         * @brief Output dims with the element strides of every input (0 on
+         * broadcast dims), collapsed like NativeElementWise does for two
+         * inputs: unit dims are dropped and adjacent dims broadcast the same
+         * way for all inputs are merged.
+         */
+        struct BroadcastLayout
+        {
+            Shape dims;
+            vector<vector<size_t>> strides;
+        };
+
+        static BroadcastLayout collapse(const vector<Shape> &shapes,
+                                        const Shape &shapeC)
+        {
+            const size_t rank = shapeC.size(), m = shapes.size();
+            BroadcastLayout layout;
+            vector<vector<bool>> full;
+            for (size_t d = 0; d < rank; ++d)
+            {
+                if (shapeC[d] == 1)
+                    continue;
+                vector<bool> f(m);
+                for (size_t i = 0; i < m; ++i)
+                {
+                    size_t pad = rank - shapes[i].size();
+                    f[i] = d >= pad && shapes[i][d - pad] != 1;
+                }
+                if (!full.empty() && full.back() == f)
+                {
+                    layout.dims.back() *= shapeC[d];
+                    continue;
+                }
+                layout.dims.emplace_back(shapeC[d]);
+                full.emplace_back(std::move(f));
+            }
+            const size_t n = layout.dims.size();
+            layout.strides.assign(m, vector<size_t>(n));
+            for (size_t i = 0; i < m; ++i)
+                for (size_t d = n, step = 1; d-- > 0;)
+                {
+                    layout.strides[i][d] = full[d][i] ? step : 0;
+                    step *= full[d][i] ? layout.dims[d] : 1;
+                }
+            return layout;
+        }
+
+        /**
+         * @brief A stack value over a block: a run of elements, or one value
+         * broadcast over the block when ptr is null.
+         */
+        template <typename T>
+        struct Slot
+        {
+            const T *ptr;
+            T value;
+        };
+
+        // Each combination of operands gets its own loop so that the
+        // compiler vectorizes it. dst may alias an operand.
+        template <typename T, typename F>
+        static Slot<T> binary(size_t n, Slot<T> x, Slot<T> y, T *dst, F f)
+        {
+            if (!x.ptr && !y.ptr)
+                return {nullptr, f(x.value, y.value)};
+            const T *a = x.ptr, *b = y.ptr;
+            if (a && b)
+            {
+#pragma omp simd
+                for (size_t i = 0; i < n; ++i)
+                    dst[i] = f(a[i], b[i]);
+            }
+            else if (a)
+            {
+                const T v = y.value;
+#pragma omp simd
+                for (size_t i = 0; i < n; ++i)
+                    dst[i] = f(a[i], v);
+            }
+            else
+            {
+                const T v = x.value;
+#pragma omp simd
+                for (size_t i = 0; i < n; ++i)
+                    dst[i] = f(v, b[i]);
+            }
+            return {dst, T()};
+        }
+
+        template <typename T, typename F>
+        static Slot<T> unary(size_t n, Slot<T> x, T *dst, F f)
+        {
+            if (!x.ptr)
+                return {nullptr, f(x.value)};
+            const T *a = x.ptr;
+#pragma omp simd
+            for (size_t i = 0; i < n; ++i)
+                dst[i] = f(a[i]);
+            return {dst, T()};
+        }
+
+        /**
+         * @brief Runs the program over n output elements. in[i] points at
+         * the first element of input i for the block, which is broadcast
+         * when inner[i] is 0. Intermediate values go to scratch, one block
+         * per stack level, and the last step writes straight to out.
+         */
+        template <typename T>
+        static void evalBlock(const vector<FusedStep> &program, size_t n,
+                              const T *const *in, const size_t *inner,
+                              T *scratch, Slot<T> *stack, T *out)
+        {
+            size_t top = 0;
+            for (size_t s = 0; s < program.size(); ++s)
+            {
+                const auto &step = program[s];
+                if (step.code == FusedStep::Input)
+                {
+                    const T *p = in[step.input];
+                    stack[top++] = inner[step.input] ? Slot<T>{p, T()}
+                                                     : Slot<T>{nullptr, *p};
+                    continue;
+                }
+                const bool isUnary = step.code == FusedStep::Relu ||
+                                     step.code == FusedStep::Clip;
+                const size_t level = isUnary ? top - 1 : top - 2;
+                T *dst = s + 1 == program.size() ? out
+                                                 : scratch + level * BlockSize;
+                Slot<T> x = stack[level], y = stack[top - 1];
+                switch (step.code)
+                {
+                case FusedStep::Add:
+                    x = binary(n, x, y, dst, [](T a, T b) { return a + b; });
+                    break;
+                case FusedStep::Sub:
+                    x = binary(n, x, y, dst, [](T a, T b) { return a - b; });
+                    break;
+                case FusedStep::Mul:
+                    x = binary(n, x, y, dst, [](T a, T b) { return a * b; });
+                    break;
+                case FusedStep::Div:
+                    x = binary(n, x, y, dst,
+                               [](T a, T b) { return (T)(a / b); });
+                    break;
+                case FusedStep::Relu:
+                    x = unary(n, x, dst,
+                              [](T a) { return std::max(T(0), a); });
+                    break;
+                case FusedStep::Clip:
+                {
+                    // Compared as float like the Clip kernel; infinite
+                    // bounds never apply.
+                    const float lo = step.min, hi = step.max;
+                    const T tlo = lo > -INFINITY ? T(lo) : T(),
+                            thi = hi < INFINITY ? T(hi) : T();
+                    x = unary(n, x, dst,
+                              [=](T a)
+                              {
+                                  return a < lo   ? tlo
+                                         : a > hi ? thi
+                                                  : a;
+                              });
+                    break;
+                }
+                default:
+                    IT_TODO_HALT();
+                }
+                stack[level] = x;
+                top = level + 1;
+            }
+            // The result is left in a slot when every input is broadcast
+            // over the block, or when the program is a lone input.
+            const Slot<T> &result = stack[0];
+            if (!result.ptr)
+                std::fill_n(out, n, result.value);
+            else if (result.ptr != out)
+                std::copy_n(result.ptr, n, out);
+        }
+
+        template <typename T>
+        CompiledKernel doCompile(const Operator &_op,
+                                 const RuntimeObj *context) const
+        {
+            auto op = as<FusedElementWiseObj>(_op);
+            const size_t m = op->numInputs();
+            vector<const T *> inptrs(m);
+            vector<Shape> shapes(m);
+            for (size_t i = 0; i < m; ++i)
+            {
+                inptrs[i] = op->getInputs(i)->getRawDataPtr<T *>();
+                shapes[i] = op->getInputs(i)->getDims();
+            }
+            T *outptr = op->getOutput()->getRawDataPtr<T *>();
+            auto layout = collapse(shapes, op->getOutput()->getDims());
+            auto program = op->getProgram();
+            const size_t depth = op->getStackDepth();
+            const size_t n = op->getOutput()->size();
+
+            return [=]
+            {
+                const auto &dims = layout.dims;
+                const size_t rank = dims.size();
+                const size_t inner = rank ? dims.back() : 1;
+                const size_t colBlocks = (inner + BlockSize - 1) / BlockSize;
+                if (n == 0)
+                    return;
+                const size_t units = n / inner * colBlocks;
+                vector<size_t> innerStride(m);
+                for (size_t i = 0; i < m; ++i)
+                    innerStride[i] = rank ? layout.strides[i].back() : 0;
+
+                const size_t unitSize = std::min(inner, BlockSize);
+                context->parallelFor(
+                    units, (GrainSize + unitSize - 1) / unitSize,
+                    [&](size_t u, size_t uEnd)
+                {
+                    // Per worker, so that chunks only allocate the first
+                    // time a thread sees a deeper program or more inputs.
+                    thread_local vector<T> scratch;
+                    thread_local vector<Slot<T>> stack;
+                    thread_local vector<const T *> in;
+                    thread_local vector<size_t> off;
+                    thread_local Shape idx;
+                    scratch.resize(depth * BlockSize);
+                    stack.resize(depth);
+                    in.resize(m);
+                    // Position of the first row by div/mod once, then
+                    // stepped with incremental counters.
+                    size_t row = u / colBlocks, cb = u % colBlocks;
+                    off.assign(m, 0);
+                    idx.assign(rank ? rank - 1 : 0, 0);
+                    for (size_t d = idx.size(), rest = row; d-- > 0;)
+                    {
+                        idx[d] = rest % dims[d];
+                        rest /= dims[d];
+                        for (size_t i = 0; i < m; ++i)
+                            off[i] += idx[d] * layout.strides[i][d];
+                    }
+                    for (; u < uEnd; ++u)
+                    {
+                        size_t j = cb * BlockSize;
+                        size_t len = std::min(BlockSize, inner - j);
+                        for (size_t i = 0; i < m; ++i)
+                            in[i] = inptrs[i] + off[i] + j * innerStride[i];
+                        evalBlock(program, len, in.data(),
+                                  innerStride.data(), scratch.data(),
+                                  stack.data(), outptr + row * inner + j);
+                        if (++cb < colBlocks)
+                            continue;
+                        cb = 0;
+                        ++row;
+                        for (size_t d = idx.size(); d-- > 0;)
+                        {
+                            for (size_t i = 0; i < m; ++i)
+                                off[i] += layout.strides[i][d];
+                            if (++idx[d] < dims[d])
+                                break;
+                            for (size_t i = 0; i < m; ++i)
+                                off[i] -= layout.strides[i][d] * dims[d];
+                            idx[d] = 0;
+                        }
+                    }
+                });
+            };
+        }
+
+        CompiledKernel compile(const Operator &_op,
+                               const RuntimeObj *context) const override
+        {
+#define CASE(N) \
+    case N:     \
+        return doCompile<DT<N>::t>(_op, context)
+
+            int dataTypeIdx = _op->getDType().getIndex();
+            switch (dataTypeIdx)
+            {
+                CASE(1); // DataType::Float32
+                CASE(12); // DataType::UInt32
+            default:
+                IT_TODO_HALT();
+            }
+            return nullptr;
+        }
+
+        void compute(const Operator &_op,
+                     const RuntimeObj *context) const override
+        {
+            compile(_op, context)();
+        }
+    };
+
+    REGISTER_KERNEL(Device::CPU, OpType::FusedElementWise,
+                    NativeFusedElementWise, "FusedElementWise_CPU");
+}; // namespace infini
@@ -0,0 +1,462 @@
+#include "kernels/cpu/gemm.h"
+#include "core/common.h"
+#include "core/runtime.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INFINI_GEMM_X86
+#endif
+
+namespace infini {
+namespace cpu {
+
+namespace {
+
+// Computes one MR x NR tile of C from packed panels. `a` holds kc columns of
+// MR rows (a[p * MR + i]) and `b` holds kc rows of NR columns (b[p * NR + j]).
+// C is overwritten unless `accumulate` is set. When `ep` is set the epilogue
+// is applied before the store, the tile being at row i0 and column j0 of C.
+using MicroKernel = void (*)(size_t kc, const float *a, const float *b,
+                             float *c, size_t ldc, bool accumulate,
+                             const GemmEpilogue *ep, size_t i0, size_t j0);
+
+struct MicroKernelInfo {
+    const char *name;
+    size_t mr, nr;
+    // Cache blocking: A blocks are mc x kc (L2), B micro panels kc x nr (L1).
+    size_t mc, kc, nc;
+    MicroKernel kernel;
+};
+
+constexpr size_t MaxTileSize = 12 * 32;
+
+float applyEpilogue(const GemmEpilogue &ep, size_t i, size_t j, float v) {
+    if (ep.bias)
+        v += ep.bias[i * ep.biasRowStride + j * ep.biasColStride];
+    return std::min(std::max(v, ep.min), ep.max);
+}
+
+template <size_t MR, size_t NR>
+void microKernelScalar(size_t kc, const float *a, const float *b, float *c,
+                       size_t ldc, bool accumulate, const GemmEpilogue *ep,
+                       size_t i0, size_t j0) {
+    float acc[MR][NR] = {};
+    for (size_t p = 0; p < kc; ++p, a += MR, b += NR)
+        for (size_t i = 0; i < MR; ++i)
+            for (size_t j = 0; j < NR; ++j)
+                acc[i][j] += a[i] * b[j];
+    for (size_t i = 0; i < MR; ++i)
+        for (size_t j = 0; j < NR; ++j) {
+            float v = accumulate ? c[i * ldc + j] + acc[i][j] : acc[i][j];
+            c[i * ldc + j] = ep ? applyEpilogue(*ep, i0 + i, j0 + j, v) : v;
+        }
+}
+
+#ifdef INFINI_GEMM_X86
+__attribute__((target("avx2,fma"))) void
+microKernelAvx2(size_t kc, const float *a, const float *b, float *c,
+                size_t ldc, bool accumulate, const GemmEpilogue *ep,
+                size_t i0, size_t j0) {
+    constexpr size_t MR = 6, NR = 16;
+    __m256 acc[MR][2];
+#pragma GCC unroll 6
+    for (size_t i = 0; i < MR; ++i)
+        acc[i][0] = acc[i][1] = _mm256_setzero_ps();
+    for (size_t p = 0; p < kc; ++p, a += MR, b += NR) {
+        __m256 b0 = _mm256_loadu_ps(b), b1 = _mm256_loadu_ps(b + 8);
+#pragma GCC unroll 6
+        for (size_t i = 0; i < MR; ++i) {
+            __m256 ai = _mm256_broadcast_ss(a + i);
+            acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+        }
+    }
+#pragma GCC unroll 6
+    for (size_t i = 0; i < MR; ++i) {
+        float *ci = c + i * ldc;
+        if (accumulate) {
+            acc[i][0] = _mm256_add_ps(acc[i][0], _mm256_loadu_ps(ci));
+            acc[i][1] = _mm256_add_ps(acc[i][1], _mm256_loadu_ps(ci + 8));
+        }
+        if (ep) {
+            if (ep->bias) {
+                const float *bi = ep->bias + (i0 + i) * ep->biasRowStride +
+                                  j0 * ep->biasColStride;
+                __m256 b0 = ep->biasColStride ? _mm256_loadu_ps(bi)
+                                              : _mm256_broadcast_ss(bi);
+                __m256 b1 = ep->biasColStride ? _mm256_loadu_ps(bi + 8) : b0;
+                acc[i][0] = _mm256_add_ps(acc[i][0], b0);
+                acc[i][1] = _mm256_add_ps(acc[i][1], b1);
+            }
+            // The bound comes first so that NaNs pass through as in Clip.
+            __m256 lo = _mm256_set1_ps(ep->min), hi = _mm256_set1_ps(ep->max);
+            acc[i][0] = _mm256_min_ps(hi, _mm256_max_ps(lo, acc[i][0]));
+            acc[i][1] = _mm256_min_ps(hi, _mm256_max_ps(lo, acc[i][1]));
+        }
+        _mm256_storeu_ps(ci, acc[i][0]);
+        _mm256_storeu_ps(ci + 8, acc[i][1]);
+    }
+}
+
+__attribute__((target("avx512f"))) void
+microKernelAvx512(size_t kc, const float *a, const float *b, float *c,
+                  size_t ldc, bool accumulate, const GemmEpilogue *ep,
+                  size_t i0, size_t j0) {
+    constexpr size_t MR = 12, NR = 32;
+    __m512 acc[MR][2];
+#pragma GCC unroll 12
+    for (size_t i = 0; i < MR; ++i)
+        acc[i][0] = acc[i][1] = _mm512_setzero_ps();
+    for (size_t p = 0; p < kc; ++p, a += MR, b += NR) {
+        __m512 b0 = _mm512_loadu_ps(b), b1 = _mm512_loadu_ps(b + 16);
+#pragma GCC unroll 12
+        for (size_t i = 0; i < MR; ++i) {
+            __m512 ai = _mm512_set1_ps(a[i]);
+            acc[i][0] = _mm512_fmadd_ps(ai, b0, acc[i][0]);
+            acc[i][1] = _mm512_fmadd_ps(ai, b1, acc[i][1]);
+        }
+    }
+#pragma GCC unroll 12
+    for (size_t i = 0; i < MR; ++i) {
+        float *ci = c + i * ldc;
+        if (accumulate) {
+            acc[i][0] = _mm512_add_ps(acc[i][0], _mm512_loadu_ps(ci));
+            acc[i][1] = _mm512_add_ps(acc[i][1], _mm512_loadu_ps(ci + 16));
+        }
+        if (ep) {
+            if (ep->bias) {
+                const float *bi = ep->bias + (i0 + i) * ep->biasRowStride +
+                                  j0 * ep->biasColStride;
+                __m512 b0 = ep->biasColStride ? _mm512_loadu_ps(bi)
+                                              : _mm512_set1_ps(*bi);
+                __m512 b1 = ep->biasColStride ? _mm512_loadu_ps(bi + 16) : b0;
+                acc[i][0] = _mm512_add_ps(acc[i][0], b0);
+                acc[i][1] = _mm512_add_ps(acc[i][1], b1);
+            }
+            // Full masks: the unmasked min/max trip a false GCC
+            // uninitialized warning.
+            __m512 lo = _mm512_set1_ps(ep->min), hi = _mm512_set1_ps(ep->max);
+            for (auto &v : acc[i]) {
+                v = _mm512_mask_max_ps(v, 0xFFFF, lo, v);
+                v = _mm512_mask_min_ps(v, 0xFFFF, hi, v);
+            }
+        }
+        _mm512_storeu_ps(ci, acc[i][0]);
+        _mm512_storeu_ps(ci + 16, acc[i][1]);
+    }
+}
+#endif
+
+const MicroKernelInfo &selectMicroKernel() {
+    static const MicroKernelInfo info = []() -> MicroKernelInfo {
+#ifdef INFINI_GEMM_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return {"avx512", 12, 32, 192, 192, 4096, microKernelAvx512};
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return {"avx2", 6, 16, 144, 256, 4080, microKernelAvx2};
+#endif
+        return {"scalar", 4, 8, 64, 256, 1024, microKernelScalar<4, 8>};
+    }();
+    return info;
+}
+
+// Packs op(A)[ic:ic+mc, pc:pc+kc] into mr-row panels, zero padding the last.
+void packA(bool transA, const float *A, size_t lda, size_t ic, size_t pc,
+           size_t mc, size_t kc, size_t mr, float *out) {
+    for (size_t ir = 0; ir < mc; ir += mr) {
+        size_t rows = std::min(mr, mc - ir);
+        for (size_t p = 0; p < kc; ++p, out += mr) {
+            size_t i = 0;
+            if (transA) {
+                const float *src = A + (pc + p) * lda + ic + ir;
+                for (; i < rows; ++i)
+                    out[i] = src[i];
+            } else {
+                const float *src = A + (ic + ir) * lda + pc + p;
+                for (; i < rows; ++i)
+                    out[i] = src[i * lda];
+            }
+            for (; i < mr; ++i)
+                out[i] = 0.f;
+        }
+    }
+}
+
+// Packs op(B)[pc:pc+kc, jc:jc+nc] into nr-column panels, zero padding the last.
+void packB(bool transB, const float *B, size_t ldb, size_t pc, size_t jc,
+           size_t kc, size_t nc, size_t nr, float *out) {
+    for (size_t jr = 0; jr < nc; jr += nr) {
+        size_t cols = std::min(nr, nc - jr);
+        for (size_t p = 0; p < kc; ++p, out += nr) {
+            size_t j = 0;
+            if (transB) {
+                const float *src = B + (jc + jr) * ldb + pc + p;
+                for (; j < cols; ++j)
+                    out[j] = src[j * ldb];
+            } else {
+                const float *src = B + (pc + p) * ldb + jc + jr;
+                for (; j < cols; ++j)
+                    out[j] = src[j];
+            }
+            for (; j < nr; ++j)
+                out[j] = 0.f;
+        }
+    }
+}
+
+size_t roundUp(size_t x, size_t m) { return (x + m - 1) / m * m; }
+
+size_t ceilDiv(size_t x, size_t m) { return (x + m - 1) / m; }
+
+// Calls body over [0, n) in chunks of whole units of work.
+void parallelFor(const RuntimeObj *context, size_t n,
+                 const std::function<void(size_t, size_t)> &body) {
+    if (context)
+        context->parallelFor(n, 1, body);
+    else if (n > 0)
+        body(0, n);
+}
+
+// Multiplies a packed mc x kc block of A with packed B panels covering nc
+// columns. Panel `jr / nr` starts at `b + jr / nr * panelStride`, which lets
+// the same routine consume both per-block and fully packed B. C is the block
+// at row ic and column jc of the output, for the epilogue if `ep` is set.
+void macroKernel(const MicroKernelInfo &uk, size_t mc, size_t nc, size_t kc,
+                 const float *a, const float *b, size_t panelStride, float *C,
+                 size_t ldc, bool accumulate, const GemmEpilogue *ep,
+                 size_t ic, size_t jc) {
+    const size_t mr = uk.mr, nr = uk.nr;
+    float tile[MaxTileSize];
+    for (size_t jr = 0; jr < nc; jr += nr, b += panelStride) {
+        size_t cols = std::min(nr, nc - jr);
+        for (size_t ir = 0; ir < mc; ir += mr) {
+            size_t rows = std::min(mr, mc - ir);
+            float *c = C + ir * ldc + jr;
+            if (rows == mr && cols == nr) {
+                uk.kernel(kc, a + ir * kc, b, c, ldc, accumulate, ep, ic + ir,
+                          jc + jr);
+                continue;
+            }
+            // Edge tile: compute into a scratch tile and copy the valid part,
+            // as the epilogue must not read bias past the edge.
+            uk.kernel(kc, a + ir * kc, b, tile, nr, false, nullptr, 0, 0);
+            for (size_t i = 0; i < rows; ++i)
+                for (size_t j = 0; j < cols; ++j) {
+                    float v = accumulate ? c[i * ldc + j] + tile[i * nr + j]
+                                         : tile[i * nr + j];
+                    c[i * ldc + j] =
+                        ep ? applyEpilogue(*ep, ic + ir + i, jc + jr + j, v)
+                           : v;
+                }
+        }
+    }
+}
+
+// Single threaded GEMM that packs B block by block.
+void sgemmSerial(const MicroKernelInfo &uk, bool transA, bool transB,
+                 size_t M, size_t N, size_t K, const float *A, size_t lda,
+                 const float *B, size_t ldb, float *C, size_t ldc,
+                 const GemmEpilogue *ep) {
+    thread_local vector<float> bufA, bufB;
+    bufA.resize(uk.mc * uk.kc);
+    bufB.resize(uk.kc * roundUp(uk.nc, uk.nr));
+    for (size_t jc = 0; jc < N; jc += uk.nc) {
+        size_t nc = std::min(uk.nc, N - jc);
+        for (size_t pc = 0; pc < K; pc += uk.kc) {
+            size_t kc = std::min(uk.kc, K - pc);
+            packB(transB, B, ldb, pc, jc, kc, nc, uk.nr, bufB.data());
+            for (size_t ic = 0; ic < M; ic += uk.mc) {
+                size_t mc = std::min(uk.mc, M - ic);
+                packA(transA, A, lda, ic, pc, mc, kc, uk.mr, bufA.data());
+                macroKernel(uk, mc, nc, kc, bufA.data(), bufB.data(),
+                            kc * uk.nr, C + ic * ldc + jc, ldc, pc > 0,
+                            pc + kc == K ? ep : nullptr, ic, jc);
+            }
+        }
+    }
+}
+
+// C for K == 0, where the product is zero.
+void zeroFill(size_t M, size_t N, float *C, size_t ldc,
+              const GemmEpilogue *ep) {
+    for (size_t i = 0; i < M; ++i) {
+        if (!ep) {
+            std::fill_n(C + i * ldc, N, 0.f);
+            continue;
+        }
+        for (size_t j = 0; j < N; ++j)
+            C[i * ldc + j] = applyEpilogue(*ep, i, j, 0.f);
+    }
+}
+
+} // namespace
+
+const char *sgemmKernelName() { return selectMicroKernel().name; }
+
+size_t sgemmPackedBSize(size_t N, size_t K) {
+    const size_t nr = selectMicroKernel().nr;
+    return ceilDiv(N, nr) * K * nr;
+}
+
+void sgemmPackB(bool transB, size_t N, size_t K, const float *B, size_t ldb,
+                float *packed, const RuntimeObj *context) {
+    const size_t nr = selectMicroKernel().nr;
+    parallelFor(context, ceilDiv(N, nr), [&](size_t p0, size_t p1) {
+        for (size_t p = p0; p < p1; ++p)
+            packB(transB, B, ldb, 0, p * nr, K, std::min(nr, N - p * nr), nr,
+                  packed + p * K * nr);
+    });
+}
+
+void sgemm(bool transA, bool transB, size_t M, size_t N, size_t K,
+           const float *A, size_t lda, const float *B, size_t ldb, float *C,
+           size_t ldc, const RuntimeObj *context,
+           const GemmEpilogue &epilogue) {
+    const size_t zero = 0;
+    sgemmBatched(transA, transB, M, N, K, A, lda, &zero, B, ldb, &zero, C,
+                 ldc, 0, 1, context, epilogue);
+}
+
+void sgemmBatched(bool transA, bool transB, size_t M, size_t N, size_t K,
+                  const float *A, size_t lda, const size_t *offsetsA,
+                  const float *B, size_t ldb, const size_t *offsetsB,
+                  float *C, size_t ldc, size_t strideC, size_t batch,
+                  const RuntimeObj *context, const GemmEpilogue &epilogue,
+                  const float *packedB) {
+    if (M == 0 || N == 0 || batch == 0)
+        return;
+    const auto &uk = selectMicroKernel();
+    const GemmEpilogue *ep = epilogue.empty() ? nullptr : &epilogue;
+    const size_t nThreads = context ? context->getNumThreads() : 1;
+
+    // Distinct A and B matrices: broadcast batches share one index.
+    auto findDistinct = [batch](const size_t *offsets, vector<size_t> &index,
+                                vector<size_t> &distinct) {
+        index.resize(batch);
+        std::unordered_map<size_t, size_t> seen;
+        for (size_t b = 0; b < batch; ++b) {
+            auto [it, inserted] = seen.emplace(offsets[b], distinct.size());
+            if (inserted)
+                distinct.emplace_back(offsets[b]);
+            index[b] = it->second;
+        }
+    };
+    vector<size_t> aIndex, distinctA, bIndex, distinctB;
+    findDistinct(offsetsA, aIndex, distinctA);
+    findDistinct(offsetsB, bIndex, distinctB);
+
+    if (K == 0) {
+        parallelFor(context, batch, [&](size_t b0, size_t b1) {
+            for (size_t b = b0; b < b1; ++b)
+                zeroFill(M, N, C + b * strideC, ldc, ep);
+        });
+        return;
+    }
+
+    // Without sharing and with enough batches to keep every thread busy,
+    // whole matrices are the best unit of work: each thread packs its own
+    // operands block by block and nothing is packed twice.
+    bool sharedA = distinctA.size() < batch;
+    bool shared = sharedA || distinctB.size() < batch;
+    if (!packedB && !shared && (nThreads == 1 || batch >= nThreads)) {
+        parallelFor(context, batch, [&](size_t b0, size_t b1) {
+            for (size_t b = b0; b < b1; ++b)
+                sgemmSerial(uk, transA, transB, M, N, K, A + offsetsA[b], lda,
+                            B + offsetsB[b], ldb, C + b * strideC, ldc, ep);
+        });
+        return;
+    }
+
+    // Otherwise every distinct B is packed once for the full K into nr-column
+    // panels and shared, read only, by all tasks that use it, unless it
+    // comes packed already.
+    const size_t nr = uk.nr, panelStride = K * nr;
+    const size_t nPanels = ceilDiv(N, nr);
+    const size_t packedSize = nPanels * panelStride;
+    vector<float> packedBuffer;
+    vector<const float *> packedOf(batch);
+    if (packedB) {
+        for (size_t b = 0; b < batch; ++b)
+            packedOf[b] = packedB + offsetsB[b] / (K * N) * packedSize;
+    } else {
+        packedBuffer.resize(distinctB.size() * packedSize);
+        parallelFor(context, distinctB.size() * nPanels,
+                    [&](size_t i0, size_t i1) {
+                        for (size_t i = i0; i < i1; ++i) {
+                            size_t d = i / nPanels, jc = i % nPanels * nr;
+                            packB(transB, B + distinctB[d], ldb, 0, jc, K,
+                                  std::min(nr, N - jc), nr,
+                                  packedBuffer.data() + d * packedSize +
+                                      jc / nr * panelStride);
+                        }
+                    });
+        for (size_t b = 0; b < batch; ++b)
+            packedOf[b] = packedBuffer.data() + bIndex[b] * packedSize;
+    }
+
+    // A broadcast A is packed once too, in mc x kc blocks shared by the
+    // tasks of every batch reading it.
+    const size_t mBlocks = ceilDiv(M, uk.mc), kBlocks = ceilDiv(K, uk.kc);
+    const size_t blockStride = roundUp(uk.mc, uk.mr) * uk.kc;
+    vector<float> packedA;
+    if (sharedA) {
+        packedA.resize(distinctA.size() * mBlocks * kBlocks * blockStride);
+        parallelFor(context, distinctA.size() * mBlocks * kBlocks,
+                    [&](size_t i0, size_t i1) {
+                        for (size_t i = i0; i < i1; ++i) {
+                            size_t d = i / (mBlocks * kBlocks);
+                            size_t ic = i / kBlocks % mBlocks * uk.mc;
+                            size_t pc = i % kBlocks * uk.kc;
+                            packA(transA, A + distinctA[d], lda, ic, pc,
+                                  std::min(uk.mc, M - ic),
+                                  std::min(uk.kc, K - pc), uk.mr,
+                                  packedA.data() + i * blockStride);
+                        }
+                    });
+    }
+
+    // Split the output of every batch into mc x nChunk tiles, narrowing the
+    // column chunks until there is enough work for all threads.
+    size_t nChunk = roundUp(std::min(N, uk.nc), nr);
+    while (nChunk > nr && batch * mBlocks * ceilDiv(N, nChunk) < 4 * nThreads)
+        nChunk = roundUp(nChunk / 2, nr);
+    const size_t nBlocks = ceilDiv(N, nChunk);
+    const size_t tasks = batch * mBlocks * nBlocks;
+
+    parallelFor(context, tasks, [&](size_t t0, size_t t1) {
+        thread_local vector<float> bufA;
+        bufA.resize(uk.mc * uk.kc);
+        for (size_t t = t0; t < t1; ++t) {
+            size_t b = t / (mBlocks * nBlocks);
+            size_t ic = t / nBlocks % mBlocks * uk.mc;
+            size_t jc = t % nBlocks * nChunk;
+            size_t mc = std::min(uk.mc, M - ic), nc = std::min(nChunk, N - jc);
+            const float *panels = packedOf[b] + jc / nr * panelStride;
+            const float *blocks =
+                sharedA ? packedA.data() +
+                              (aIndex[b] * mBlocks + ic / uk.mc) * kBlocks *
+                                  blockStride
+                        : nullptr;
+            float *c = C + b * strideC + ic * ldc + jc;
+            for (size_t pc = 0; pc < K; pc += uk.kc) {
+                size_t kc = std::min(uk.kc, K - pc);
+                const float *a = bufA.data();
+                if (sharedA)
+                    a = blocks + pc / uk.kc * blockStride;
+                else
+                    packA(transA, A + offsetsA[b], lda, ic, pc, mc, kc, uk.mr,
+                          bufA.data());
+                macroKernel(uk, mc, nc, kc, a, panels + pc * nr, panelStride,
+                            c, ldc, pc > 0, pc + kc == K ? ep : nullptr, ic,
+                            jc);
+            }
+        }
+    });
+}
+
+} // namespace cpu
+} // namespace infini
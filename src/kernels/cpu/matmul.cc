@@ -0,0 +1,169 @@
+#include "operators/matmul.h"
+#include "core/kernel.h"
+#include "kernels/cpu/gemm.h"
+
+namespace infini {
+
+class NativeMatmul : public CpuKernelWithoutConfig {
+    // Offset (in elements) of the matrix of an operand used by every output
+    // batch. Leading dims of size 1 are broadcast.
+    static vector<size_t> getBatchOffsets(const Shape &operand,
+                                          const Shape &output) {
+        size_t rank = operand.size() - 2, outRank = output.size() - 2;
+        IT_ASSERT(rank <= outRank);
+        Shape stride(outRank, 0);
+        size_t step = operand[rank] * operand[rank + 1];
+        for (size_t i = rank; i-- > 0;) {
+            stride[outRank - rank + i] = operand[i] == 1 ? 0 : step;
+            step *= operand[i];
+        }
+        size_t batch = 1;
+        for (size_t i = 0; i < outRank; ++i)
+            batch *= output[i];
+        vector<size_t> offsets(batch);
+        for (size_t b = 0; b < batch; ++b) {
+            size_t rest = b, offset = 0;
+            for (size_t i = outRank; i-- > 0;) {
+                offset += rest % output[i] * stride[i];
+                rest /= output[i];
+            }
+            offsets[b] = offset;
+        }
+        return offsets;
+    }
+
+    // Epilogue of op on its output matrix. The bias is broadcast over the
+    // batches, see MatmulObj::canFuseBias().
+    static cpu::GemmEpilogue getEpilogue(const Ref<MatmulObj> &op) {
+        cpu::GemmEpilogue ep;
+        ep.min = op->getClipMin();
+        ep.max = op->getClipMax();
+        if (auto bias = op->getBias()) {
+            const auto &dims = bias->getDims();
+            size_t rank = dims.size();
+            size_t rows = rank > 1 ? dims[rank - 2] : 1,
+                   cols = rank > 0 ? dims[rank - 1] : 1;
+            ep.bias = bias->getRawDataPtr<float *>();
+            ep.biasRowStride = rows != 1 ? cols : 0;
+            ep.biasColStride = cols != 1 ? 1 : 0;
+        }
+        return ep;
+    }
+
+    // Panels of a constant B packed for the GEMM, once per tensor and
+    // layout, or null when B is not constant.
+    static const float *getPackedB(const Tensor &B, bool transB, size_t N,
+                                   size_t K, const RuntimeObj *context) {
+        if (!B->isConstant())
+            return nullptr;
+        string layout = string("sgemm-") + cpu::sgemmKernelName() +
+                        (transB ? "-T" : "-N");
+        auto packed = B->getPackedData(layout);
+        if (!packed) {
+            size_t size = cpu::sgemmPackedBSize(N, K),
+                   count = N && K ? B->size() / (N * K) : 0;
+            packed = make_ref<BlobObj>(B->getRuntime(),
+                                       count * size * sizeof(float));
+            auto src = B->getRawDataPtr<float *>();
+            auto dst = packed->getPtr<float *>();
+            for (size_t i = 0; i < count; ++i)
+                cpu::sgemmPackB(transB, N, K, src + i * N * K,
+                                transB ? K : N, dst + i * size, context);
+            B->setPackedData(layout, packed);
+        }
+        return packed->getPtr<float *>();
+    }
+
+    template <typename T>
+    static void gemmBatched(const RuntimeObj *context, bool transA,
+                            bool transB, size_t M, size_t N, size_t K,
+                            const T *A, const vector<size_t> &offA, const T *B,
+                            const vector<size_t> &offB, T *C,
+                            const cpu::GemmEpilogue &ep,
+                            const float *packedB) {
+        size_t lda = transA ? M : K, ldb = transB ? K : N;
+        if constexpr (std::is_same_v<T, float>) {
+            cpu::sgemmBatched(transA, transB, M, N, K, A, lda, offA.data(), B,
+                              ldb, offB.data(), C, N, M * N, offA.size(),
+                              context, ep, packedB);
+        } else {
+            // Bias of the same dtype as C; bounds compared as float like
+            // the Clip kernel, infinite ones never apply.
+            const T *bias = reinterpret_cast<const T *>(ep.bias);
+            const T lo = ep.min > -INFINITY ? T(ep.min) : T(),
+                    hi = ep.max < INFINITY ? T(ep.max) : T();
+            context->parallelFor(offA.size(), 1, [&](size_t b0, size_t b1) {
+                for (size_t b = b0; b < b1; ++b) {
+                    const T *a = A + offA[b], *bm = B + offB[b];
+                    T *c = C + b * M * N;
+                    for (size_t i = 0; i < M; ++i)
+                        for (size_t j = 0; j < N; ++j) {
+                            T acc = 0;
+                            for (size_t p = 0; p < K; ++p)
+                                acc += (transA ? a[p * lda + i]
+                                               : a[i * lda + p]) *
+                                       (transB ? bm[j * ldb + p]
+                                               : bm[p * ldb + j]);
+                            if (bias)
+                                acc += bias[i * ep.biasRowStride +
+                                            j * ep.biasColStride];
+                            c[i * N + j] = acc < ep.min   ? lo
+                                           : acc > ep.max ? hi
+                                                          : acc;
+                        }
+                }
+            });
+        }
+    }
+
+    template <typename T>
+    CompiledKernel doCompile(const Operator &_op,
+                             const RuntimeObj *context) const {
+        auto op = as<MatmulObj>(_op);
+        auto A = op->getInputs(0), B = op->getInputs(1), C = op->getOutput();
+        const auto shapeA = A->getDims(), shapeB = B->getDims(),
+                   shapeC = C->getDims();
+        size_t M = op->getM(), N = op->getN(), K = op->getK();
+        bool transA = op->getTransA(), transB = op->getTransB();
+        // Broadcast batches get equal offsets, which lets the GEMM pack a
+        // shared operand once for all of them.
+        auto offsetsA = getBatchOffsets(shapeA, shapeC),
+             offsetsB = getBatchOffsets(shapeB, shapeC);
+        auto a = A->getRawDataPtr<T *>(), b = B->getRawDataPtr<T *>(),
+             c = C->getRawDataPtr<T *>();
+        auto ep = getEpilogue(op);
+        const float *packedB = nullptr;
+        if constexpr (std::is_same_v<T, float>)
+            packedB = getPackedB(B, transB, N, K, context);
+        return [=, offsetsA = std::move(offsetsA),
+                offsetsB = std::move(offsetsB)] {
+            gemmBatched<T>(context, transA, transB, M, N, K, a, offsetsA, b,
+                           offsetsB, c, ep, packedB);
+        };
+    }
+
+    CompiledKernel compile(const Operator &_op,
+                           const RuntimeObj *context) const override {
+#define CASE(N)                                                                \
+    case N:                                                                    \
+        return doCompile<DT<N>::t>(_op, context)
+
+        int dataTypeIdx = _op->getDType().getIndex();
+        switch (dataTypeIdx) {
+            CASE(1); // DataType::Float32
+            CASE(12); // DataType::UInt32
+        default:
+            IT_TODO_HALT();
+        }
+        return nullptr;
+    }
+
+    void compute(const Operator &_op,
+                 const RuntimeObj *context) const override {
+        compile(_op, context)();
+    }
+};
+
+REGISTER_KERNEL(Device::CPU, OpType::MatMul, NativeMatmul, "MatMul_CPU");
+
+} // namespace infini
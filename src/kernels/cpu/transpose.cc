@@ -1,60 +1,274 @@
 #include "operators/transpose.h"
 #include "core/kernel.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INFINI_TRANSPOSE_X86
+#endif
 
 namespace infini {
 
-inline Shape idx2Pos(const Shape &shape, size_t idx) {
-    Shape pos = Shape(shape.size(), 0);
-    auto rest = idx, curDimId = shape.size() - 1;
-    while (rest > 0) {
-        pos[curDimId] = rest % shape[curDimId];
-        rest /= shape[curDimId];
-        curDimId--;
+namespace {
+
+// Tiles of the 2D transpose are TileSize x TileSize elements.
+constexpr size_t TileSize = 32;
+// Minimum elements per parallel chunk.
+constexpr size_t GrainSize = 1 << 14;
+
+/**
+ * @brief Input dims and permutation after dropping unit dims and merging
+ * input dims that stay adjacent and in order in the output.
+ */
+struct TransposeLayout {
+    Shape dims;       // reduced input dims
+    vector<int> perm; // output dim j is input dim perm[j]
+};
+
+TransposeLayout simplify(const Shape &inDim, const vector<int> &permute) {
+    // Drop unit dims, renumbering the remaining ones.
+    vector<int> newIndex(inDim.size(), -1);
+    Shape dims;
+    for (size_t i = 0; i < inDim.size(); ++i)
+        if (inDim[i] != 1) {
+            newIndex[i] = dims.size();
+            dims.emplace_back(inDim[i]);
+        }
+    vector<int> perm;
+    for (auto p : permute)
+        if (newIndex[p] >= 0)
+            perm.emplace_back(newIndex[p]);
+
+    // Group runs p, p + 1, ... of consecutive input dims in output order.
+    vector<pair<int, int>> groups; // [first, last] input dim, output order
+    for (auto p : perm) {
+        if (!groups.empty() && groups.back().second + 1 == p)
+            groups.back().second = p;
+        else
+            groups.emplace_back(p, p);
+    }
+    vector<int> order(groups.size());
+    for (size_t g = 0; g < order.size(); ++g)
+        order[g] = g;
+    std::sort(order.begin(), order.end(), [&](int x, int y) {
+        return groups[x].first < groups[y].first;
+    });
+    TransposeLayout layout;
+    layout.dims.resize(groups.size());
+    layout.perm.resize(groups.size());
+    for (size_t k = 0; k < order.size(); ++k) {
+        auto [first, last] = groups[order[k]];
+        ShapeElem size = 1;
+        for (int d = first; d <= last; ++d)
+            size *= dims[d];
+        layout.dims[k] = size;
+        layout.perm[order[k]] = k;
+    }
+    return layout;
+}
+
+/**
+ * @brief Walks a flattened range of "outer" positions, keeping the matching
+ * input and output element offsets up to date with incremental counters.
+ */
+struct OuterIterator {
+    const Shape &dims;
+    const vector<size_t> &inStride, &outStride;
+    Shape idx;
+    size_t in = 0, out = 0;
+
+    OuterIterator(const Shape &dims, const vector<size_t> &inStride,
+                  const vector<size_t> &outStride, size_t start)
+        : dims(dims), inStride(inStride), outStride(outStride),
+          idx(dims.size(), 0) {
+        for (size_t d = dims.size(); d-- > 0;) {
+            idx[d] = start % dims[d];
+            start /= dims[d];
+            in += idx[d] * inStride[d];
+            out += idx[d] * outStride[d];
+        }
+    }
+
+    void next() {
+        for (size_t d = dims.size(); d-- > 0;) {
+            in += inStride[d];
+            out += outStride[d];
+            if (++idx[d] < dims[d])
+                return;
+            in -= inStride[d] * dims[d];
+            out -= outStride[d] * dims[d];
+            idx[d] = 0;
+        }
+    }
+};
+
+#ifdef INFINI_TRANSPOSE_X86
+bool hasAvx() {
+    static const bool avx = (__builtin_cpu_init(),
+                             __builtin_cpu_supports("avx"));
+    return avx;
+}
+
+// 8x8 register transpose of 32-bit elements: out[a * oa + b] = in[b * ib + a]
+__attribute__((target("avx"))) void transpose8x8(const void *in, size_t ib,
+                                                 void *out, size_t oa) {
+    auto src = static_cast<const float *>(in);
+    auto dst = static_cast<float *>(out);
+    __m256 r[8], t[8];
+    for (int i = 0; i < 8; ++i)
+        r[i] = _mm256_loadu_ps(src + i * ib);
+    for (int i = 0; i < 8; i += 2) {
+        t[i] = _mm256_unpacklo_ps(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_ps(r[i], r[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4) {
+        r[i] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+        r[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+        r[i + 2] =
+            _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+        r[i + 3] =
+            _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+    }
+    for (int i = 0; i < 4; ++i) {
+        _mm256_storeu_ps(dst + i * oa,
+                         _mm256_permute2f128_ps(r[i], r[i + 4], 0x20));
+        _mm256_storeu_ps(dst + (i + 4) * oa,
+                         _mm256_permute2f128_ps(r[i], r[i + 4], 0x31));
+    }
+}
+#endif
+
+// out[a * oa + b] = in[b * ib + a] for a < na, b < nb, tile by tile.
+template <typename T>
+void transpose2D(const T *in, size_t ib, T *out, size_t oa, size_t nb,
+                 size_t na) {
+    for (size_t a0 = 0; a0 < na; a0 += TileSize) {
+        size_t aEnd = std::min(na, a0 + TileSize);
+        size_t b = 0;
+#ifdef INFINI_TRANSPOSE_X86
+        if (sizeof(T) == 4 && hasAvx())
+            for (; b + 8 <= nb; b += 8) {
+                size_t a = a0;
+                for (; a + 8 <= aEnd; a += 8)
+                    transpose8x8(in + b * ib + a, ib, out + a * oa + b, oa);
+                for (; a < aEnd; ++a)
+                    for (size_t bb = b; bb < b + 8; ++bb)
+                        out[a * oa + bb] = in[bb * ib + a];
+            }
+#endif
+        for (; b < nb; ++b)
+            for (size_t a = a0; a < aEnd; ++a)
+                out[a * oa + b] = in[b * ib + a];
     }
-    return pos;
 }
 
-class NaiveTranspose : public CpuKernelWithoutConfig {
+} // namespace
+
+class NativeTranspose : public CpuKernelWithoutConfig {
     template <typename T>
-    void doCompute(const Operator &_op, const RuntimeObj *context) const {
+    CompiledKernel doCompile(const Operator &_op,
+                             const RuntimeObj *context) const {
         auto op = as<TransposeObj>(_op);
-        auto inputs = op->getInputs(), outputs = op->getOutputs();
-        const auto &inDim = inputs[0]->getDims();
-        const auto &perm = op->getPermute();
-
-        size_t inSize = inputs[0]->size();
-        auto inPtr = inputs[0]->getRawDataPtr<T *>(),
-             outPtr = outputs[0]->getRawDataPtr<T *>();
-        // #pragma omp parallel for
-        for (size_t inIdx = 0; inIdx < inSize; ++inIdx) {
-            auto posInput = idx2Pos(inDim, inIdx);
-            int outIdx = 0;
-            for (size_t j = 0, jEnd = perm.size(); j < jEnd; ++j) {
-                outIdx = outIdx * inDim[perm[j]] + posInput[perm[j]];
-            }
-            outPtr[outIdx] = inPtr[inIdx];
+        auto input = op->getInputs(0), output = op->getOutput();
+        auto inPtr = input->getRawDataPtr<T *>(),
+             outPtr = output->getRawDataPtr<T *>();
+        const size_t size = input->size();
+        const auto layout = simplify(input->getDims(), op->getPermute());
+        const size_t rank = layout.dims.size();
+        if (size == 0)
+            return [] {};
+        if (rank <= 1)
+            return [=] { std::memcpy(outPtr, inPtr, size * sizeof(T)); };
+
+        vector<size_t> inStride(rank), outStride(rank);
+        Shape outDims(rank);
+        for (size_t d = rank, step = 1; d-- > 0; step *= layout.dims[d])
+            inStride[d] = step;
+        for (size_t j = rank, step = 1; j-- > 0; step *= outDims[j]) {
+            outDims[j] = layout.dims[layout.perm[j]];
+            outStride[j] = step;
         }
+
+        // Outer dims exclude output dims handled by the inner copy.
+        Shape dims;
+        vector<size_t> outerIn, outerOut;
+        auto collectOuter = [&](size_t skip0, size_t skip1) {
+            for (size_t j = 0; j < rank; ++j)
+                if (j != skip0 && j != skip1) {
+                    dims.emplace_back(outDims[j]);
+                    outerIn.emplace_back(inStride[layout.perm[j]]);
+                    outerOut.emplace_back(outStride[j]);
+                }
+        };
+
+        if (layout.perm.back() == (int)rank - 1) {
+            // Innermost input dim is preserved: copy contiguous runs.
+            const size_t run = layout.dims.back();
+            const size_t rows = size / run;
+            collectOuter(rank - 1, rank - 1);
+            return [=] {
+                context->parallelFor(
+                    rows, (GrainSize + run - 1) / run,
+                    [&](size_t r0, size_t r1) {
+                        OuterIterator it(dims, outerIn, outerOut, r0);
+                        for (size_t r = r0; r < r1; ++r, it.next())
+                            std::memcpy(outPtr + it.out, inPtr + it.in,
+                                        run * sizeof(T));
+                    });
+            };
+        }
+
+        // Otherwise every outer position is a 2D transpose between the input
+        // innermost dim (a) and the input dim that becomes the output
+        // innermost dim (b), done in tiles of TileSize rows of b.
+        const size_t posA = std::find(layout.perm.begin(), layout.perm.end(),
+                                      (int)rank - 1) -
+                            layout.perm.begin();
+        const size_t na = layout.dims.back(), nb = outDims.back();
+        const size_t ib = inStride[layout.perm.back()], oa = outStride[posA];
+        collectOuter(posA, rank - 1);
+        const size_t bands = (nb + TileSize - 1) / TileSize;
+        const size_t units = size / (na * nb) * bands;
+        const size_t unitSize = na * std::min(TileSize, nb);
+        return [=] {
+            context->parallelFor(
+                units, (GrainSize + unitSize - 1) / unitSize,
+                [&](size_t u0, size_t u1) {
+                    for (size_t u = u0; u < u1; ++u) {
+                        OuterIterator it(dims, outerIn, outerOut, u / bands);
+                        size_t b0 = u % bands * TileSize;
+                        transpose2D(inPtr + it.in + b0 * ib, ib,
+                                    outPtr + it.out + b0, oa,
+                                    std::min(TileSize, nb - b0), na);
+                    }
+                });
+        };
     }
 
-    void compute(const Operator &_op,
-                 const RuntimeObj *context) const override {
+    CompiledKernel compile(const Operator &_op,
+                           const RuntimeObj *context) const override {
 #define CASE(N)                                                                \
     case N:                                                                    \
-        doCompute<DT<N>::t>(_op, context)
+        return doCompile<DT<N>::t>(_op, context)
 
         int dataTypeIdx = _op->getDType().getIndex();
         switch (dataTypeIdx) {
             CASE(1); // DataType::Float32
-            break;
             CASE(12); // DataType::UInt32
-            break;
         default:
             IT_TODO_HALT();
         }
+        return nullptr;
+    }
+
+    void compute(const Operator &_op,
+                 const RuntimeObj *context) const override {
+        compile(_op, context)();
     }
 };
 
-REGISTER_KERNEL(Device::CPU, OpType::Transpose, NaiveTranspose,
-                "TransposeNaive_CPU");
+REGISTER_KERNEL(Device::CPU, OpType::Transpose, NativeTranspose,
+                "Transpose_CPU");
 
 } // namespace infini
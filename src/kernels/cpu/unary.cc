@@ -3,6 +3,9 @@
 
 namespace infini
 {
+    // Minimum elements per parallel chunk.
+    static constexpr size_t GrainSize = 1 << 14;
+
     class NativeUnary : public CpuKernelWithoutConfig
     {
         template <typename T>
@@ -12,13 +15,13 @@ namespace infini
         }
 
         template <typename T>
-        void doCompute(const Operator &_op, const RuntimeObj *context) const
+        CompiledKernel doCompile(const Operator &_op,
+                                 const RuntimeObj *context) const
         {
             auto op = as<UnaryObj>(_op);
             T *inptr = op->getInputs(0)->getRawDataPtr<T *>();
             T *outptr = op->getOutput()->getRawDataPtr<T *>();
 
-            auto outDim = op->getOutput()->getDims();
             auto n = op->getOutput()->size();
 
             T (*_doCompute)
@@ -32,36 +35,50 @@ namespace infini
                 IT_TODO_HALT();
             }
 
-            for (size_t offset = 0; offset < n; offset++)
+            // Safe when planned in place (outptr == inptr).
+            return [=]
             {
-                outptr[offset] = _doCompute(inptr[offset]);
-            }
+                context->parallelFor(
+                    n, GrainSize, [&](size_t begin, size_t end)
+                    {
+                        for (size_t offset = begin; offset < end; offset++)
+                        {
+                            outptr[offset] = _doCompute(inptr[offset]);
+                        }
+                    });
+            };
         }
 
-        void compute(const Operator &_op,
-                     const RuntimeObj *context) const override
+        CompiledKernel compile(const Operator &_op,
+                               const RuntimeObj *context) const override
         {
 #define CASE(N) \
     case N:     \
-        doCompute<DT<N>::t>(_op, context)
+        return doCompile<DT<N>::t>(_op, context)
 
             int dataTypeIdx = _op->getDType().getIndex();
             switch (dataTypeIdx)
             {
                 CASE(1); // DataType::Float32
-                break;
                 CASE(12); // DataType::UInt32
-                break;
             default:
                 IT_TODO_HALT();
             }
+            return nullptr;
+        }
+
+        void compute(const Operator &_op,
+                     const RuntimeObj *context) const override
+        {
+            compile(_op, context)();
         }
     };
 
     class Clip : public CpuKernelWithoutConfig
     {
         template <typename T>
-        void doCompute(const Operator &_op, const RuntimeObj *context) const
+        CompiledKernel doCompile(const Operator &_op,
+                                 const RuntimeObj *context) const
         {
             auto op = as<ClipObj>(_op);
             T *inptr = op->getInputs(0)->getRawDataPtr<T *>();
@@ -70,32 +87,49 @@ namespace infini
             auto maxValue = op->getMax();
 
             auto n = op->getOutput()->size();
-            for (size_t offset = 0; offset < n; offset++)
+            // Each value is loaded before its slot is stored, so the output
+            // may share the input buffer.
+            return [=]
             {
-                auto val = *inptr++;
-                *outptr++ = (minValue && val < *minValue)   ? *minValue
-                            : (maxValue && val > *maxValue) ? *maxValue
-                                                            : val;
-            }
+                context->parallelFor(
+                    n, GrainSize, [&](size_t begin, size_t end)
+                    {
+                        auto in = inptr + begin;
+                        auto out = outptr + begin;
+                        for (size_t offset = begin; offset < end; offset++)
+                        {
+                            auto val = *in++;
+                            *out++ = (minValue && val < *minValue) ? *minValue
+                                     : (maxValue && val > *maxValue)
+                                         ? *maxValue
+                                         : val;
+                        }
+                    });
+            };
         }
 
-        void compute(const Operator &_op,
-                     const RuntimeObj *context) const override
+        CompiledKernel compile(const Operator &_op,
+                               const RuntimeObj *context) const override
         {
 #define CASE(N) \
     case N:     \
-        doCompute<DT<N>::t>(_op, context)
+        return doCompile<DT<N>::t>(_op, context)
 
             int dataTypeIdx = _op->getDType().getIndex();
             switch (dataTypeIdx)
             {
                 CASE(1); // DataType::Float32
-                break;
                 CASE(12); // DataType::UInt32
-                break;
             default:
                 IT_TODO_HALT();
             }
+            return nullptr;
+        }
+
+        void compute(const Operator &_op,
+                     const RuntimeObj *context) const override
+        {
+            compile(_op, context)();
         }
     };
 
@@ -0,0 +1,152 @@
+#include "operators/fused_element_wise.h"
+#include "operators/element_wise.h"
+#include "operators/unary.h"
+#include "utils/operator_utils.h"
+
+namespace infini
+{
+    FusedElementWiseObj::FusedElementWiseObj(GraphObj *graph, TensorVec inputs,
+                                             Tensor output,
+                                             vector<FusedStep> program)
+        : OperatorObj(OpType::FusedElementWise, inputs, {output}),
+          program(std::move(program))
+    {
+        IT_ASSERT(!inputs.empty());
+        size_t depth = 0;
+        for (const auto &step : this->program)
+        {
+            switch (step.code)
+            {
+            case FusedStep::Input:
+                IT_ASSERT(step.input >= 0 && step.input < (int)inputs.size());
+                stackDepth = std::max(stackDepth, ++depth);
+                break;
+            case FusedStep::Relu:
+            case FusedStep::Clip:
+                IT_ASSERT(depth >= 1);
+                break;
+            default:
+                IT_ASSERT(depth >= 2);
+                --depth;
+            }
+        }
+        IT_ASSERT(depth == 1, "Fused program must leave one value");
+        IT_ASSERT(checkValid(graph));
+    }
+
+    optional<vector<Shape>> FusedElementWiseObj::inferShape(
+        const TensorVec &inputs)
+    {
+        Shape res = inputs[0]->getDims();
+        for (size_t i = 1; i < inputs.size(); ++i)
+            res = infer_broadcast(res, inputs[i]->getDims());
+        return {{res}};
+    }
+
+    size_t FusedElementWiseObj::getFlops() const
+    {
+        size_t steps = 0;
+        for (const auto &step : program)
+            steps += step.code != FusedStep::Input;
+        return steps * outputs[0]->size();
+    }
+
+    vector<int> FusedElementWiseObj::getOpAttrVector() const
+    {
+        vector<int> ret{type.underlying()};
+        for (const auto &step : program)
+            ret.insert(ret.end(), {step.code, step.input, attrOf(step.min),
+                                   attrOf(step.max)});
+        return ret;
+    }
+
+    std::string FusedElementWiseObj::toString() const
+    {
+        static const char *names[]{"in", "Add", "Sub", "Mul",
+                                   "Div", "Relu", "Clip"};
+        vector<string> stack;
+        for (const auto &step : program)
+        {
+            if (step.code == FusedStep::Input)
+            {
+                stack.emplace_back("in" + std::to_string(step.input));
+                continue;
+            }
+            string arg = stack.back();
+            if (step.code == FusedStep::Relu || step.code == FusedStep::Clip)
+            {
+                stack.back() = string(names[step.code]) + "(" + arg + ")";
+                continue;
+            }
+            stack.pop_back();
+            stack.back() =
+                string(names[step.code]) + "(" + stack.back() + "," + arg + ")";
+        }
+        std::ostringstream os;
+        os << type.toString() << "[" << getGuid() << "]";
+        os << "(" << stack.back() << ",";
+        for (size_t i = 0; i < inputs.size(); ++i)
+            os << "input" << i << "=" << inputs[i]->getGuid() << ",";
+        os << "output=" << outputs[0]->getGuid() << ")";
+        return os.str();
+    }
+
+    bool FusedElementWiseObj::isFusible(const Operator &op)
+    {
+        switch (op->getOpType().underlying())
+        {
+        case OpType::Add:
+        case OpType::Sub:
+        case OpType::Mul:
+        case OpType::Div:
+        case OpType::Relu:
+        case OpType::Clip:
+        case OpType::FusedElementWise:
+            break;
+        default:
+            return false;
+        }
+        auto dtype = op->getOutput()->getDType();
+        return dtype == DataType::Float32 || dtype == DataType::UInt32;
+    }
+
+    vector<FusedStep> FusedElementWiseObj::programOf(const Operator &op)
+    {
+        IT_ASSERT(isFusible(op));
+        if (op->getOpType() == OpType::FusedElementWise)
+            return as<FusedElementWiseObj>(op)->getProgram();
+        vector<FusedStep> ret;
+        for (int i = 0; i < (int)op->getInputs().size(); ++i)
+            ret.push_back({FusedStep::Input, i});
+        switch (op->getOpType().underlying())
+        {
+        case OpType::Add:
+            ret.push_back({FusedStep::Add});
+            break;
+        case OpType::Sub:
+            ret.push_back({FusedStep::Sub});
+            break;
+        case OpType::Mul:
+            ret.push_back({FusedStep::Mul});
+            break;
+        case OpType::Div:
+            ret.push_back({FusedStep::Div});
+            break;
+        case OpType::Relu:
+            ret.push_back({FusedStep::Relu});
+            break;
+        case OpType::Clip:
+        {
+            auto clip = as<ClipObj>(op);
+            ret.push_back({FusedStep::Clip, 0,
+                           clip->getMin().value_or(-INFINITY),
+                           clip->getMax().value_or(INFINITY)});
+            break;
+        }
+        default:
+            IT_TODO_HALT();
+        }
+        return ret;
+    }
+
+}; // namespace infini
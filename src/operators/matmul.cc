@@ -16,11 +16,66 @@ namespace infini
         std::ostringstream os;
         os << "Matmul([" << (transA ? "A^T" : "A") << "," << (transB ? "B^T" : "B]")
            << ",A=" << inputs[0]->getGuid()
-           << ",B=" << inputs[1]->getGuid() << ",C=" << outputs[0]->getGuid()
-           << ",mnk=[" << m << "," << n << "," << k << "])";
+           << ",B=" << inputs[1]->getGuid();
+        if (auto bias = getBias())
+            os << ",bias=" << bias->getGuid();
+        if (hasClip())
+            os << ",clip=[" << clipMin << "," << clipMax << "]";
+        os << ",C=" << outputs[0]->getGuid()
+           << ",mnk=[" << getM() << "," << getN() << "," << getK() << "])";
         return os.str();
     }
 
+    vector<int> MatmulObj::getOpAttrVector() const
+    {
+        return {type.underlying(), transA, transB, attrOf(clipMin),
+                attrOf(clipMax)};
+    }
+
+    int MatmulObj::getM() const
+    {
+        const auto &dims = inputs[0]->getDims();
+        return dims[dims.size() - (transA ? 1 : 2)];
+    }
+
+    int MatmulObj::getN() const
+    {
+        const auto &dims = inputs[1]->getDims();
+        return dims[dims.size() - (transB ? 2 : 1)];
+    }
+
+    int MatmulObj::getK() const
+    {
+        const auto &dims = inputs[0]->getDims();
+        return dims[dims.size() - (transA ? 2 : 1)];
+    }
+
+    void MatmulObj::fuseClip(float min, float max)
+    {
+        IT_ASSERT(min <= max);
+        // clip(clip(x, a, b), c, d) == clip(x, clip(a, c, d), clip(b, c, d))
+        clipMin = std::min(std::max(clipMin, min), max);
+        clipMax = std::min(std::max(clipMax, min), max);
+    }
+
+    bool MatmulObj::canFuseBias(const Tensor &bias) const
+    {
+        if (getBias() || hasClip() || !(bias->getDType() == getDType()))
+            return false;
+        const auto &out = outputs[0]->getDims();
+        const auto &dims = bias->getDims();
+        if (dims.size() > out.size())
+            return false;
+        for (size_t i = 0; i < dims.size(); ++i)
+        {
+            size_t d = out.size() - dims.size() + i;
+            // Batch dims must be broadcast, matrix dims equal or broadcast.
+            if (dims[i] != 1 && (d + 2 < out.size() || dims[i] != out[d]))
+                return false;
+        }
+        return true;
+    }
+
     optional<vector<Shape>> MatmulObj::inferShape(const TensorVec &inputs)
     {
         // =================================== 作业 ===================================
@@ -66,6 +121,10 @@ namespace infini
         ret.emplace_back(m);
         ret.emplace_back(n);
 
+        // 偏置只能广播到输出上，不能改变输出形状
+        if (inputs.size() > 2)
+            IT_ASSERT(infer_broadcast(ret, inputs[2]->getDims()) == ret);
+
         return {{ret}};
     }
 
@@ -61,4 +61,11 @@ namespace infini
         os << "output=" << outputs[0]->getGuid() << ")";
         return os.str();
     }
+
+    vector<int> TransposeObj::getOpAttrVector() const
+    {
+        vector<int> ret{type.underlying()};
+        ret.insert(ret.end(), transposePermute.begin(), transposePermute.end());
+        return ret;
+    }
 }; // namespace infini
@@ -54,6 +54,13 @@ namespace infini
         return os.str();
     }
 
+    vector<int> ClipObj::getOpAttrVector() const
+    {
+        // An absent bound is the same as an infinite one.
+        return {type.underlying(), attrOf(minValue.value_or(-INFINITY)),
+                attrOf(maxValue.value_or(INFINITY))};
+    }
+
     CastObj::CastObj(GraphObj *graph, Tensor input, Tensor output, CastType type)
         : OperatorObj(OpType::Cast, {input}, {output}), castType(type)
     {
@@ -71,4 +71,63 @@ namespace infini
         EXPECT_EQ(ptr1, ptr2);
     }
 
+    TEST(Allocator, testBestFit)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        for (auto policy : {AllocPolicy::FirstFit, AllocPolicy::BestFit})
+        {
+            Allocator allocator = Allocator(runtime, policy);
+            // leave a 32 byte hole at 0 and a 16 byte hole at 40
+            size_t offsetA = allocator.alloc(32);
+            allocator.alloc(8);
+            size_t offsetC = allocator.alloc(16);
+            allocator.alloc(8);
+            allocator.free(offsetA, 32);
+            allocator.free(offsetC, 16);
+            size_t offsetD = allocator.alloc(16);
+            EXPECT_EQ(offsetD, policy == AllocPolicy::BestFit ? offsetC
+                                                                : offsetA);
+            EXPECT_EQ(allocator.getPeak(), 64u);
+        }
+    }
+
+    TEST(Allocator, testCoalesce)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        for (auto policy : {AllocPolicy::FirstFit, AllocPolicy::BestFit})
+        {
+            Allocator allocator = Allocator(runtime, policy);
+            size_t offsetA = allocator.alloc(8);
+            size_t offsetB = allocator.alloc(8);
+            size_t offsetC = allocator.alloc(8);
+            allocator.alloc(8);
+            // freeing b last must merge it with both neighbours
+            allocator.free(offsetA, 8);
+            allocator.free(offsetC, 8);
+            allocator.free(offsetB, 8);
+            EXPECT_EQ(allocator.alloc(24), offsetA);
+            EXPECT_EQ(allocator.getPeak(), 32u);
+        }
+    }
+
+    TEST(Allocator, testReset)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Allocator allocator = Allocator(runtime);
+        allocator.alloc(64);
+        void *ptr = allocator.getPtr();
+        // the plan is frozen once bound
+        EXPECT_THROW(allocator.alloc(8), Exception);
+        // a smaller plan reuses the memory, a larger one grows it
+        allocator.reset();
+        EXPECT_EQ(allocator.alloc(32), 0u);
+        EXPECT_EQ(allocator.getPtr(), ptr);
+        EXPECT_EQ(allocator.getCapacity(), 64u);
+        allocator.reset();
+        allocator.alloc(128);
+        EXPECT_NE(allocator.getPtr(), nullptr);
+        EXPECT_EQ(allocator.getPeak(), 128u);
+        EXPECT_EQ(allocator.getCapacity(), 128u);
+    }
+
 } // namespace infini
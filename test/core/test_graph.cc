@@ -1,10 +1,14 @@
 #include "core/graph.h"
 #include "core/kernel.h"
 #include "core/runtime.h"
+#include "operators/element_wise.h"
+#include "operators/fused_element_wise.h"
 #include "operators/matmul.h"
 #include "operators/transpose.h"
+#include "operators/unary.h"
 
 #include "test.h"
+#include <functional>
 
 namespace infini
 {
@@ -37,4 +41,545 @@ namespace infini
         EXPECT_EQ(op->getTransA(), false);
         EXPECT_EQ(op->getTransB(), true);
     }
-}
\ No newline at end of file
+
+    TEST(Graph, OptimizeKeepsSharedTranspose)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor i = g->addTensor({1, 4, 4}, DataType::Float32);
+        auto t = g->addOp<TransposeObj>(i, nullptr, Shape{0, 2, 1})
+                     ->getOutput();
+        g->addOp<MatmulObj>(t, i, nullptr);
+        g->addOp<AddObj>(t, i, nullptr);
+        // The Add still reads the transposed tensor.
+        g->optimize();
+        EXPECT_EQ(g->getOperators().size(), 3u);
+        EXPECT_TRUE(g->checkValid());
+    }
+
+    // Optimizes a graph built by build, checks the op types left in any
+    // order, and that the outputs match those of the unoptimized graph.
+    static void expectOptimizesTo(
+        const std::function<TensorVec(const Graph &)> &build,
+        const vector<OpType> &types)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        auto run = [&](const Graph &g, const TensorVec &inputs)
+        {
+            g->dataMalloc();
+            for (auto &input : inputs)
+                input->setData(IncrementalGenerator());
+            runtime->run(g);
+            return g->getOutputs();
+        };
+        Graph g = make_ref<GraphObj>(runtime);
+        auto expected = run(g, build(g));
+        Graph f = make_ref<GraphObj>(runtime);
+        auto inputs = build(f);
+        f->optimize();
+        EXPECT_TRUE(f->checkValid());
+        vector<OpType::underlying_t> left, want;
+        for (auto &op : f->getOperators())
+            left.emplace_back(op->getOpType().underlying());
+        for (auto type : types)
+            want.emplace_back(type.underlying());
+        std::sort(left.begin(), left.end());
+        std::sort(want.begin(), want.end());
+        EXPECT_EQ(left, want);
+        auto outputs = run(f, inputs);
+        ASSERT_EQ(outputs.size(), expected.size());
+        for (size_t i = 0; i < outputs.size(); ++i)
+        {
+            EXPECT_EQ(outputs[i]->getDims(), expected[i]->getDims());
+            EXPECT_TRUE(outputs[i]->equalData(expected[i]));
+        }
+    }
+
+    TEST(Graph, OptimizeSimplifiesTransposes)
+    {
+        auto transpose = [](const Graph &g, const Tensor &x,
+                            const vector<int> &perm)
+        { return g->addOp<TransposeObj>(x, nullptr, perm)->getOutput(); };
+        // Not an involution, so the pair composes instead of cancelling.
+        expectOptimizesTo(
+            [&](const Graph &g)
+            {
+                auto a = g->addTensor({2, 3, 4});
+                transpose(g, transpose(g, a, {1, 2, 0}), {1, 2, 0});
+                return TensorVec{a};
+            },
+            {OpType::Transpose});
+        // Three rotations are the identity.
+        expectOptimizesTo(
+            [&](const Graph &g)
+            {
+                auto a = g->addTensor({2, 3, 4});
+                auto x = a;
+                for (int i = 0; i < 3; ++i)
+                    x = transpose(g, x, {1, 2, 0});
+                g->addOp<ReluObj>(x, nullptr);
+                return TensorVec{a};
+            },
+            {OpType::Relu});
+        // Moved below the element-wise ops to meet their inverse.
+        expectOptimizesTo(
+            [&](const Graph &g)
+            {
+                auto a = g->addTensor({2, 3, 4});
+                auto x = transpose(g, a, {2, 0, 1});
+                x = g->addOp<ReluObj>(x, nullptr)->getOutput();
+                transpose(g, x, {1, 2, 0});
+                return TensorVec{a};
+            },
+            {OpType::Relu});
+        expectOptimizesTo(
+            [&](const Graph &g)
+            {
+                auto a = g->addTensor({2, 3, 4}), b = g->addTensor({2, 3, 4});
+                auto x = g->addOp<AddObj>(transpose(g, a, {2, 0, 1}),
+                                          transpose(g, b, {2, 0, 1}),
+                                          nullptr)
+                             ->getOutput();
+                transpose(g, x, {1, 2, 0});
+                return TensorVec{a, b};
+            },
+            {OpType::Add});
+        // Composed for each reader, and folded into the MatMul, so the
+        // shared Transpose goes away.
+        expectOptimizesTo(
+            [&](const Graph &g)
+            {
+                auto a = g->addTensor({2, 3, 4}), b = g->addTensor({2, 3, 5});
+                auto x = transpose(g, a, {0, 2, 1});
+                g->addOp<ReluObj>(transpose(g, x, {0, 2, 1}), nullptr);
+                transpose(g, x, {1, 0, 2});
+                g->addOp<MatmulObj>(x, b, nullptr);
+                return TensorVec{a, b};
+            },
+            {OpType::Relu, OpType::Transpose, OpType::MatMul});
+    }
+
+    TEST(Graph, OptimizeFusesElementWise)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        auto build = [](const Graph &g)
+        {
+            Tensor a = g->addTensor({2, 3, 4}, DataType::Float32);
+            Tensor b = g->addTensor({4}, DataType::Float32);
+            Tensor c = g->addTensor({2, 1, 4}, DataType::Float32);
+            auto x = g->addOp<AddObj>(a, b, nullptr)->getOutput();
+            // x is also read by the Sub, so its Add stays on its own. The
+            // Relu and the Clip compose into one clamp.
+            auto y = g->addOp<ReluObj>(x, nullptr)->getOutput();
+            y = g->addOp<ClipObj>(y, nullptr, 1.f, 20.f)->getOutput();
+            y = g->addOp<MulObj>(y, c, nullptr)->getOutput();
+            g->addOp<SubObj>(y, x, nullptr);
+            return TensorVec{a, b, c};
+        };
+        auto run = [&](const Graph &g, const TensorVec &inputs)
+        {
+            g->dataMalloc();
+            inputs[0]->setData(IncrementalGenerator());
+            inputs[1]->setData(ValGenerator<2>());
+            inputs[2]->setData(IncrementalGenerator());
+            runtime->run(g);
+            return g->getOutputs();
+        };
+
+        Graph g = make_ref<GraphObj>(runtime);
+        auto expected = run(g, build(g));
+        Graph f = make_ref<GraphObj>(runtime);
+        auto inputs = build(f);
+        f->optimize();
+        ASSERT_EQ(f->getOperators().size(), 2u);
+        EXPECT_EQ(f->getOperators()[0]->getOpType(), OpType::Add);
+        auto fused = as<FusedElementWiseObj>(f->getOperators()[1]);
+        EXPECT_EQ(fused->getOpType(), OpType::FusedElementWise);
+        EXPECT_EQ(fused->numInputs(), 2);
+        EXPECT_EQ(fused->getProgram().size(), 6u);
+        EXPECT_EQ(f->getTensors().size(), 5u);
+        EXPECT_TRUE(f->checkValid());
+        auto outputs = run(f, inputs);
+        ASSERT_EQ(outputs.size(), 1u);
+        EXPECT_TRUE(outputs[0]->equalData(expected[0]));
+    }
+
+    TEST(Graph, OptimizeFusesMatmulEpilogue)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor a = g->addTensor({1, 4, 8}, DataType::Float32);
+        Tensor w = g->addTensor({8, 16}, DataType::Float32);
+        Tensor b = g->addTensor({16}, DataType::Float32);
+        Tensor batched = g->addTensor({2, 1, 16}, DataType::Float32);
+        auto y = g->addOp<MatmulObj>(a, w, nullptr)->getOutput();
+        y = g->addOp<AddObj>(y, b, nullptr)->getOutput();
+        y = g->addOp<ReluObj>(y, nullptr)->getOutput();
+        // A bias varying across batches is left to an Add, which the Mul
+        // reading its output twice does not absorb.
+        y = g->addOp<AddObj>(y, batched, nullptr)->getOutput();
+        y = g->addOp<MulObj>(y, y, nullptr)->getOutput();
+        g->optimize();
+        ASSERT_EQ(g->getOperators().size(), 3u);
+        auto ops = g->getOperators();
+        auto it = std::find_if(ops.begin(), ops.end(), [](auto &op)
+                               { return op->getOpType() == OpType::MatMul; });
+        ASSERT_NE(it, ops.end());
+        auto mm = as<MatmulObj>(*it);
+        EXPECT_EQ(mm->getBias(), b);
+        EXPECT_EQ(mm->getClipMin(), 0.f);
+        EXPECT_EQ(mm->getClipMax(), INFINITY);
+        EXPECT_EQ(mm->getOutput()->getTargets().size(), 1u);
+        EXPECT_EQ(mm->getOutput()->getTargets()[0]->getOpType(),
+                  OpType::Add);
+        EXPECT_EQ(g->getTensors().size(), 7u);
+        EXPECT_TRUE(g->checkValid());
+    }
+
+    TEST(Graph, OptimizeFoldsConstants)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        auto build = [](const Graph &g, bool constant)
+        {
+            Tensor x = g->addTensor({1, 2, 3}, DataType::Float32);
+            Tensor w = g->addTensor({4, 3}, DataType::Float32);
+            Tensor s = g->addTensor({4, 3}, DataType::Float32);
+            if (constant)
+            {
+                w->setConstant();
+                s->setConstant();
+                w->setData(IncrementalGenerator());
+                s->setData(ValGenerator<2>());
+            }
+            // Only the MatMul reads x, everything else is constant.
+            auto wt = g->addOp<TransposeObj>(w, nullptr, Shape{1, 0});
+            auto st = g->addOp<TransposeObj>(s, nullptr, Shape{1, 0});
+            auto b = g->addOp<MulObj>(wt->getOutput(), st->getOutput(),
+                                      nullptr);
+            auto out = g->addOp<MatmulObj>(x, b->getOutput(), nullptr)
+                           ->getOutput();
+            return TensorVec{x, w, s, out};
+        };
+
+        Graph g = make_ref<GraphObj>(runtime);
+        auto expected = build(g, false);
+        g->dataMalloc();
+        for (int i : {0, 1})
+            expected[i]->setData(IncrementalGenerator());
+        expected[2]->setData(ValGenerator<2>());
+        runtime->run(g);
+
+        Graph f = make_ref<GraphObj>(runtime);
+        auto tensors = build(f, true);
+        f->optimize();
+        ASSERT_EQ(f->getOperators().size(), 1u);
+        auto mm = f->getOperators()[0];
+        EXPECT_EQ(mm->getOpType(), OpType::MatMul);
+        auto b = mm->getInputs(1);
+        EXPECT_TRUE(b->isConstant());
+        EXPECT_FALSE(b->getSource());
+        EXPECT_TRUE(b->equalData(vector<float>{0, 6, 12, 18, 2, 8, 14, 20,
+                                               4, 10, 16, 22}));
+        // The weights it was computed from are gone.
+        EXPECT_EQ(f->getTensors().size(), 3u);
+        EXPECT_TRUE(f->checkValid());
+
+        f->dataMalloc();
+        // Only x and the output are in the planned memory.
+        EXPECT_EQ(f->getMemoryPeak(), (6 + 8) * sizeof(float));
+        tensors[0]->setData(IncrementalGenerator());
+        runtime->run(f);
+        EXPECT_TRUE(tensors[3]->equalData(expected[3]));
+    }
+
+    TEST(Graph, OptimizeEliminatesCommonSubexpressions)
+    {
+        expectOptimizesTo(
+            [](const Graph &g)
+            {
+                auto a = g->addTensor({2, 3, 4});
+                auto x = g->addOp<ReluObj>(a, nullptr)->getOutput();
+                auto y = g->addOp<ReluObj>(a, nullptr)->getOutput();
+                auto z = g->addOp<AddObj>(x, y, nullptr)->getOutput();
+                // Equal once their inputs are merged.
+                auto t = g->addOp<TransposeObj>(z, nullptr, Shape{1, 0, 2});
+                auto u = g->addOp<TransposeObj>(z, nullptr, Shape{1, 0, 2});
+                g->addOp<SubObj>(t->getOutput(), u->getOutput(), nullptr);
+                // Different permutation.
+                g->addOp<TransposeObj>(z, nullptr, Shape{0, 2, 1});
+                return TensorVec{a};
+            },
+            {OpType::Relu, OpType::Add, OpType::Transpose, OpType::Sub,
+             OpType::Transpose});
+    }
+
+    TEST(Graph, OptimizeRemovesDeadOperators)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor a = g->addTensor({2, 3}, DataType::Float32);
+        Tensor b = g->addTensor({2, 3}, DataType::Float32);
+        Tensor w = g->addTensor({2, 3}, DataType::Float32);
+        w->setConstant();
+        w->setData(IncrementalGenerator());
+        auto y = g->addOp<ReluObj>(a, nullptr)->getOutput();
+        auto out = g->addOp<AddObj>(y, y, nullptr)->getOutput();
+        // A dangling branch, the only reader of b and w.
+        auto d = g->addOp<MulObj>(b, w, nullptr)->getOutput();
+        g->addOp<ReluObj>(g->addOp<AddObj>(d, y, nullptr)->getOutput(),
+                          nullptr);
+        // y is read by the Add but is an output too.
+        g->setOutputs({y, out});
+
+        g->optimize();
+        ASSERT_EQ(g->getOperators().size(), 2u);
+        EXPECT_EQ(g->getOperators()[0]->getOpType(), OpType::Relu);
+        EXPECT_EQ(g->getOperators()[1]->getOpType(), OpType::Add);
+        EXPECT_EQ(g->getTensors(), (TensorVec{a, y, out}));
+        EXPECT_EQ(g->getOutputs(), (TensorVec{y, out}));
+        EXPECT_TRUE(g->checkValid());
+
+        g->dataMalloc();
+        // The Add does not overwrite y in place.
+        EXPECT_EQ(g->getMemoryPeak(), 3 * 6 * sizeof(float));
+        a->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(y->equalData(vector<float>{0, 1, 2, 3, 4, 5}));
+        EXPECT_TRUE(out->equalData(vector<float>{0, 2, 4, 6, 8, 10}));
+    }
+
+    TEST(Graph, RemoveKeepsOrder)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor a = g->addTensor({2, 3}, DataType::Float32);
+        Tensor b = g->addTensor({2, 3}, DataType::Float32);
+        auto r = g->addOp<ReluObj>(a, nullptr);
+        auto s = g->addOp<ReluObj>(b, nullptr);
+        auto t = g->addOp<ReluObj>(a, nullptr);
+        EXPECT_EQ(g->getTensor(s->getOutput()->getFuid()), s->getOutput());
+
+        g->removeOperator(s);
+        g->removeTensor(b);
+        g->removeTensor(s->getOutput());
+        EXPECT_EQ(g->getOperators(), (OpVec{r, t}));
+        EXPECT_EQ(g->getTensors(),
+                  (TensorVec{a, r->getOutput(), t->getOutput()}));
+        EXPECT_FALSE(g->hasOperator(s));
+        EXPECT_TRUE(g->hasOperator(t));
+        EXPECT_EQ(g->getTensor(s->getOutput()->getFuid()), nullptr);
+        EXPECT_EQ(g->getTensor(t->getOutput()->getFuid()), t->getOutput());
+        EXPECT_TRUE(g->checkValid());
+    }
+
+    TEST(Graph, ShapeInferRevisitsChangedOps)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor x = g->addTensor({2, 3, 4}, DataType::Float32);
+        Tensor w = g->addTensor({3, 5}, DataType::Float32);
+        Tensor b = g->addTensor({4, 4}, DataType::Float32);
+        auto t = g->addOp<TransposeObj>(x, nullptr, Shape{0, 2, 1});
+        auto r = g->addOp<ReluObj>(t->getOutput(), nullptr);
+        auto y = g->addOp<MatmulObj>(r->getOutput(), w, nullptr)->getOutput();
+        auto other = g->addOp<ReluObj>(b, nullptr)->getOutput();
+
+        // Set behind the back of the graph: only a full pass repairs it.
+        other->setShape({1});
+        g->setShape(x, {6, 3, 4});
+        g->shape_infer();
+        EXPECT_EQ(r->getOutput()->getDims(), (Shape{6, 4, 3}));
+        EXPECT_EQ(y->getDims(), (Shape{6, 4, 5}));
+        EXPECT_EQ(other->getDims(), (Shape{1}));
+        g->shape_infer();
+        EXPECT_EQ(other->getDims(), (Shape{4, 4}));
+
+        // Back to a memoized shape, then a new one.
+        g->setShape(x, {2, 3, 4});
+        g->shape_infer();
+        EXPECT_EQ(y->getDims(), (Shape{2, 4, 5}));
+        g->setShape(x, {1, 3, 4});
+        g->shape_infer();
+        EXPECT_EQ(y->getDims(), (Shape{1, 4, 5}));
+        EXPECT_EQ(y->size(), 20u);
+    }
+
+    TEST(Graph, TopoSort)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor i = g->addTensor({2, 3}, DataType::Float32);
+        Tensor a = g->addTensor({2, 3}, DataType::Float32);
+        Tensor b = g->addTensor({2, 3}, DataType::Float32);
+        Tensor c = g->addTensor({2, 3}, DataType::Float32);
+        Tensor o = g->addTensor({2, 3}, DataType::Float32);
+        // Inserted consumers first; add reads a twice.
+        auto add = g->addOpWithOutputs<AddObj>(a, a, o);
+        auto mul = g->addOpWithOutputs<MulObj>(b, c, a);
+        auto reluC = g->addOpWithOutputs<ReluObj>(i, c);
+        auto reluB = g->addOpWithOutputs<ReluObj>(i, b);
+        ASSERT_TRUE(g->topo_sort());
+        EXPECT_EQ(g->getOperators(), (OpVec{reluC, reluB, mul, add}));
+        EXPECT_EQ(g->getLevelOffsets(), (vector<size_t>{0, 2, 3, 4}));
+
+        // A cycle cannot be sorted and leaves the order untouched.
+        Graph cyclic = make_ref<GraphObj>(runtime);
+        Tensor x = cyclic->addTensor({2}, DataType::Float32);
+        Tensor y = cyclic->addTensor({2}, DataType::Float32);
+        cyclic->addOpWithOutputs<ReluObj>(x, y);
+        cyclic->addOpWithOutputs<ReluObj>(y, x);
+        auto before = cyclic->getOperators();
+        EXPECT_FALSE(cyclic->topo_sort());
+        EXPECT_EQ(cyclic->getOperators(), before);
+    }
+
+    TEST(Graph, DataMallocReusesDeadTensors)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor i = g->addTensor({1, 1024}, DataType::Float32);
+        Tensor t = i;
+        for (int k = 0; k < 8; ++k)
+            t = g->addOp<ReluObj>(t, nullptr)->getOutput();
+        g->dataMalloc();
+        // Only the first Relu reads the graph input; the rest run in place,
+        // so the input plus one intermediate buffer is enough.
+        EXPECT_EQ(g->getMemoryPeak(), 2 * i->getBytes());
+        EXPECT_EQ(g->getNaiveMemorySize(), 9 * i->getBytes());
+        for (auto &op : g->getOperators())
+            EXPECT_EQ(op->getInplaceInput(),
+                      op->getInputs(0) == i ? -1 : 0);
+
+        i->setData(IncrementalGenerator());
+        runtime->run(g);
+        vector<float> expected(1024);
+        for (size_t k = 0; k < expected.size(); ++k)
+            expected[k] = k;
+        EXPECT_TRUE(t->equalData(expected));
+    }
+
+    TEST(Graph, DataMallocInplace)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor a = g->addTensor({2, 3}, DataType::Float32);
+        Tensor b = g->addTensor({3}, DataType::Float32);
+        auto relu = g->addOp<ReluObj>(a, nullptr);
+        // b is broadcast, so only the Relu output can be reused by Add
+        auto add = g->addOp<AddObj>(b, relu->getOutput(), nullptr);
+        auto clip = g->addOp<ClipObj>(add->getOutput(), nullptr, std::nullopt,
+                                      6.0f);
+        g->dataMalloc();
+        EXPECT_EQ(relu->getInplaceInput(), -1);
+        EXPECT_EQ(add->getInplaceInput(), 1);
+        EXPECT_EQ(clip->getInplaceInput(), 0);
+        EXPECT_EQ(clip->getOutput()->getRawDataPtr<void *>(),
+                  relu->getOutput()->getRawDataPtr<void *>());
+
+        a->setData(IncrementalGenerator());
+        b->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(
+            clip->getOutput()->equalData(vector<float>{0, 2, 4, 3, 5, 6}));
+    }
+
+    TEST(Graph, ReshapeCachesPlans)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        auto build = [](const Graph &g, int batch)
+        {
+            Tensor x = g->addTensor({1, batch, 3}, DataType::Float32);
+            Tensor w = g->addTensor({3, 4}, DataType::Float32);
+            w->setConstant();
+            w->setData(IncrementalGenerator());
+            auto y = g->addOp<ReluObj>(x, nullptr)->getOutput();
+            y = g->addOp<MatmulObj>(y, w, nullptr)->getOutput();
+            y = g->addOp<AddObj>(y, y, nullptr)->getOutput();
+            return TensorVec{x, y};
+        };
+        auto expected = [&](int batch)
+        {
+            Graph g = make_ref<GraphObj>(runtime);
+            auto tensors = build(g, batch);
+            g->dataMalloc();
+            tensors[0]->setData(IncrementalGenerator());
+            runtime->run(g);
+            return tensors[1];
+        };
+
+        Graph g = make_ref<GraphObj>(runtime);
+        auto tensors = build(g, 2);
+        auto x = tensors[0], y = tensors[1];
+        g->dataMalloc();
+        x->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(y->equalData(expected(2)));
+        const size_t peak = g->getMemoryPeak();
+
+        // A batch of 3 runs in the bucket of 4, in a larger buffer.
+        EXPECT_EQ(GraphObj::bucketOf(3), 4);
+        g->reshape({{x, {1, GraphObj::bucketOf(3), 3}}});
+        EXPECT_EQ(y->getDims(), (Shape{1, 4, 4}));
+        EXPECT_GT(g->getMemoryPeak(), peak);
+        EXPECT_TRUE(g->getPlan().steps.empty());
+        x->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(y->equalData(expected(4)));
+
+        // Back to the first bucket. Its memory plan is reused, its kernels
+        // are compiled again as they were bound to the smaller buffer.
+        g->reshape({{x, {1, 2, 3}}});
+        EXPECT_EQ(g->getMemoryPeak(), peak);
+        EXPECT_TRUE(g->getPlan().steps.empty());
+        auto small = x->getRawDataPtr<void *>();
+        x->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(y->equalData(expected(2)));
+
+        // From now on, both buckets keep their compiled kernels.
+        for (int batch : {4, 2})
+        {
+            g->reshape({{x, {1, batch, 3}}});
+            EXPECT_EQ(g->getPlan().steps.size(), g->getOperators().size());
+        }
+        EXPECT_EQ(x->getRawDataPtr<void *>(), small);
+    }
+
+    TEST(Graph, ReshapeUpdatesMatmulSizes)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        auto build = [](const Graph &g, int m)
+        {
+            Tensor x = g->addTensor({1, m, 3}, DataType::Float32);
+            Tensor w = g->addTensor({3, 4}, DataType::Float32);
+            w->setConstant();
+            w->setData(IncrementalGenerator());
+            auto mm = g->addOp<MatmulObj>(x, w, nullptr);
+            return std::make_pair(x, mm);
+        };
+        auto expected = [&](int m)
+        {
+            Graph g = make_ref<GraphObj>(runtime);
+            auto [x, mm] = build(g, m);
+            g->dataMalloc();
+            x->setData(IncrementalGenerator());
+            runtime->run(g);
+            return mm->getOutput();
+        };
+
+        Graph g = make_ref<GraphObj>(runtime);
+        auto [x, mm] = build(g, 4);
+        g->dataMalloc();
+        // M comes back to 4 through memoized shapes and a cached memory plan
+        // whose kernels were dropped when the buffer grew.
+        for (int m : {8, 4})
+        {
+            g->reshape({{x, {1, m, 3}}});
+            EXPECT_EQ(mm->getM(), m);
+            EXPECT_EQ(mm->getOutput()->getDims(), (Shape{1, m, 4}));
+            x->setData(IncrementalGenerator());
+            runtime->run(g);
+            EXPECT_TRUE(mm->getOutput()->equalData(expected(m)));
+        }
+    }
+}
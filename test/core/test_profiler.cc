@@ -0,0 +1,97 @@
+#include "core/graph.h"
+#include "core/profiler.h"
+#include "core/runtime.h"
+#include "operators/matmul.h"
+#include "operators/transpose.h"
+#include "operators/unary.h"
+
+#include "test.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace infini
+{
+    TEST(Profiler, AggregatesRuns)
+    {
+        auto runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        auto a = g->addTensor({16, 8}, DataType::Float32);
+        auto b = g->addTensor({16, 4}, DataType::Float32);
+        auto t = g->addOp<TransposeObj>(a, nullptr, Shape{1, 0});
+        auto matmul = g->addOp<MatmulObj>(t->getOutput(), b, nullptr);
+        g->addOp<ReluObj>(matmul->getOutput(), nullptr);
+        g->dataMalloc();
+        a->setData(IncrementalGenerator());
+        b->setData(IncrementalGenerator());
+
+        // Runs without profiling are not recorded.
+        runtime->run(g);
+        runtime->setProfiling(true);
+        runtime->getProfiler().clear();
+        for (int k = 0; k < 3; ++k)
+            runtime->run(g);
+        runtime->setProfiling(false);
+        runtime->run(g);
+
+        const auto &profiler = runtime->getProfiler();
+        EXPECT_EQ(profiler.getNumRuns(), 3u);
+        auto ops = profiler.getOpRecords();
+        ASSERT_EQ(ops.size(), 3u);
+        for (size_t i = 0; i < ops.size(); ++i)
+        {
+            EXPECT_EQ(ops[i].calls, 3u);
+            EXPECT_LE(ops[i].minUs, ops[i].avgUs());
+            EXPECT_LE(ops[i].avgUs(), ops[i].maxUs);
+            if (i > 0)
+            {
+                EXPECT_GE(ops[i - 1].totalUs, ops[i].totalUs);
+            }
+        }
+        auto it = std::find_if(ops.begin(), ops.end(), [](const auto &r)
+                               { return r.type == OpType::MatMul; });
+        ASSERT_NE(it, ops.end());
+        EXPECT_EQ(it->kernel, "MatMul_CPU");
+        EXPECT_EQ(it->flops, 2u * 8 * 16 * 4);
+        EXPECT_EQ(it->bytes, (8u * 16 + 16 * 4 + 8 * 4) * sizeof(float));
+        EXPECT_EQ(it->name, "MatMul_" + to_string(matmul->getGuid()));
+
+        auto types = profiler.getTypeRecords();
+        EXPECT_EQ(types.size(), 3u);
+        EXPECT_NE(profiler.report().find("MatMul_CPU"), string::npos);
+
+        string path = ::testing::TempDir() + "profiler_trace.json";
+        profiler.dumpTrace(path);
+        std::ifstream file(path);
+        std::stringstream trace;
+        trace << file.rdbuf();
+        std::remove(path.c_str());
+        EXPECT_EQ(trace.str().rfind("{\"traceEvents\":[", 0), 0u);
+        size_t events = 0;
+        for (size_t pos = 0;
+             (pos = trace.str().find("\"ph\":\"X\"", pos)) != string::npos;
+             ++pos)
+            ++events;
+        EXPECT_EQ(events, 9u);
+    }
+
+    TEST(Profiler, InterOpRuns)
+    {
+        auto runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        auto x = g->addTensor({64}, DataType::Float32);
+        for (int k = 0; k < 4; ++k)
+            g->addOp<ReluObj>(x, nullptr);
+        g->dataMalloc();
+        runtime->setNumThreads(2, 1);
+        runtime->setProfiling(true);
+        runtime->getProfiler().clear();
+        runtime->run(g);
+        runtime->setProfiling(false);
+        runtime->setNumThreads(1, 0);
+        auto types = runtime->getProfiler().getTypeRecords();
+        ASSERT_EQ(types.size(), 1u);
+        EXPECT_EQ(types[0].calls, 4u);
+        EXPECT_EQ(types[0].kernel, "reluNaive_CPU");
+    }
+} // namespace infini
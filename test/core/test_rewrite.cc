@@ -0,0 +1,213 @@
+#include "core/graph.h"
+#include "core/pass_manager.h"
+#include "core/runtime.h"
+#include "operators/element_wise.h"
+#include "operators/matmul.h"
+#include "operators/transpose.h"
+#include "operators/unary.h"
+
+#include "test.h"
+
+namespace infini
+{
+    // Relu(Transpose(x)) -> Transpose(Relu(x))
+    static RewriteRule sinkRelu()
+    {
+        return {"sink-relu",
+                Pattern(OpType::Relu).input(Pattern(OpType::Transpose)),
+                [](Rewriter &rewriter, const OpVec &match)
+                {
+                    auto transpose = as<TransposeObj>(match[1]);
+                    auto x = transpose->getInputs(0);
+                    auto y = rewriter.addTensor(x->getDims(), x->getDType());
+                    rewriter.addOp<ReluObj>(x, y);
+                    rewriter.addOp<TransposeObj>(y, match[0]->getOutput(),
+                                                 transpose->getPermute());
+                    return true;
+                }};
+    }
+
+    TEST(Rewrite, ReplacesMatches)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        auto build = [](const Graph &g)
+        {
+            Tensor a = g->addTensor({2, 3, 4}, DataType::Float32);
+            auto t = g->addOp<TransposeObj>(a, nullptr, Shape{2, 0, 1});
+            g->addOp<ReluObj>(t->getOutput(), nullptr);
+            return a;
+        };
+        Graph g = make_ref<GraphObj>(runtime);
+        auto a = build(g);
+        g->dataMalloc();
+        a->setData(IncrementalGenerator());
+        runtime->run(g);
+
+        Graph f = make_ref<GraphObj>(runtime);
+        auto b = build(f);
+        EXPECT_EQ(f->applyRewrites({sinkRelu()}), vector<size_t>{1});
+        ASSERT_EQ(f->getOperators().size(), 2u);
+        auto relu = b->getTargets().at(0);
+        EXPECT_EQ(relu->getOpType(), OpType::Relu);
+        EXPECT_EQ(relu->getOutput()->getTargets().at(0)->getOpType(),
+                  OpType::Transpose);
+        // The output of the old Transpose is gone, the new Relu has one.
+        EXPECT_EQ(f->getTensors().size(), 3u);
+        EXPECT_TRUE(f->checkValid());
+        f->dataMalloc();
+        b->setData(IncrementalGenerator());
+        runtime->run(f);
+        EXPECT_TRUE(f->getOutputs()[0]->equalData(g->getOutputs()[0]));
+    }
+
+    TEST(Rewrite, MatchesOnlyRemovableProducers)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor a = g->addTensor({2, 3}, DataType::Float32);
+        auto t = g->addOp<TransposeObj>(a, nullptr, Shape{1, 0})->getOutput();
+        g->addOp<ReluObj>(t, nullptr);
+        // The Transpose is read by the Add too.
+        g->addOp<AddObj>(t, t, nullptr);
+        EXPECT_EQ(g->applyRewrites({sinkRelu()}), vector<size_t>{0});
+        EXPECT_EQ(g->getOperators().size(), 3u);
+
+        // Neither is a marked output.
+        Graph h = make_ref<GraphObj>(runtime);
+        a = h->addTensor({2, 3}, DataType::Float32);
+        t = h->addOp<TransposeObj>(a, nullptr, Shape{1, 0})->getOutput();
+        auto r = h->addOp<ReluObj>(t, nullptr)->getOutput();
+        h->setOutputs({t, r});
+        EXPECT_EQ(h->applyRewrites({sinkRelu()}), vector<size_t>{0});
+    }
+
+    TEST(Rewrite, PatternInputIndex)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor a = g->addTensor({2, 3}, DataType::Float32);
+        Tensor b = g->addTensor({2, 3}, DataType::Float32);
+        auto ra = g->addOp<ReluObj>(a, nullptr)->getOutput();
+        auto rb = g->addOp<ReluObj>(b, nullptr)->getOutput();
+        auto first = g->addOp<SubObj>(ra, b, nullptr);
+        auto second = g->addOp<SubObj>(a, rb, nullptr);
+        auto isOutput = [](const Tensor &) { return false; };
+
+        auto pattern = Pattern(OpType::Sub).input(Pattern(OpType::Relu), 1);
+        OpVec match;
+        EXPECT_FALSE(pattern.match(first, isOutput, match));
+        EXPECT_TRUE(match.empty());
+        EXPECT_TRUE(pattern.match(second, isOutput, match));
+        EXPECT_EQ(match, (OpVec{second, rb->getSource()}));
+
+        // Predicates apply to every op of the pattern.
+        match.clear();
+        auto none = Pattern(OpType::Sub).input(
+            Pattern(OpType::Relu).where([](const Operator &op)
+                                        { return op->getGuid() < 0; }));
+        EXPECT_FALSE(none.match(second, isOutput, match));
+        EXPECT_EQ(pattern.depth(), 2);
+    }
+
+    TEST(Rewrite, DeclinedRewriteLeavesGraph)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor a = g->addTensor({2, 3}, DataType::Float32);
+        auto t = g->addOp<TransposeObj>(a, nullptr, Shape{1, 0})->getOutput();
+        g->addOp<ReluObj>(t, nullptr);
+        RewriteRule decline{
+            "decline", Pattern(OpType::Relu).input(Pattern(OpType::Transpose)),
+            [](Rewriter &rewriter, const OpVec &)
+            {
+                rewriter.addTensor({3, 2}, DataType::Float32);
+                return false;
+            }};
+        EXPECT_EQ(g->applyRewrites({decline}), vector<size_t>{0});
+        EXPECT_EQ(g->getOperators().size(), 2u);
+        EXPECT_EQ(g->getTensors().size(), 3u);
+        EXPECT_TRUE(g->checkValid());
+    }
+
+    TEST(Rewrite, OptimizeRecordsPassStats)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor a = g->addTensor({1, 4, 8}, DataType::Float32);
+        Tensor w = g->addTensor({8, 16}, DataType::Float32);
+        auto y = g->addOp<MatmulObj>(a, w, nullptr)->getOutput();
+        y = g->addOp<ReluObj>(y, nullptr)->getOutput();
+        g->addOp<ClipObj>(y, nullptr, -1.f, 6.f);
+        g->optimize();
+        EXPECT_EQ(g->getOperators().size(), 1u);
+
+        const auto &stats = g->getPassStats();
+        auto epilogue =
+            std::find_if(stats.begin(), stats.end(), [](const PassStats &s)
+                         { return s.name == "epilogue"; });
+        ASSERT_NE(epilogue, stats.end());
+        EXPECT_EQ(epilogue->opsBefore, 3u);
+        EXPECT_EQ(epilogue->opsAfter, 1u);
+        // The Clip composes with the Relu first, or is folded after it.
+        EXPECT_EQ(epilogue->rewrites, 2u);
+        size_t total = 0;
+        for (const auto &[rule, count] : epilogue->rules)
+            total += count;
+        EXPECT_EQ(total, 2u);
+        EXPECT_EQ(stats.front().opsBefore, 3u);
+        EXPECT_EQ(stats.back().opsAfter, 1u);
+        EXPECT_NE(PassManager::report(stats).find("matmul-relu"),
+                  string::npos);
+    }
+
+    static const PassStats &statsOf(const Graph &g, const string &name)
+    {
+        const auto &stats = g->getPassStats();
+        auto it = std::find_if(stats.begin(), stats.end(),
+                               [&](const PassStats &s)
+                               { return s.name == name; });
+        IT_ASSERT(it != stats.end());
+        return *it;
+    }
+
+    TEST(Rewrite, PassStatsCountRemainingOps)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        Tensor a = g->addTensor({2, 3}, DataType::Float32);
+        auto r1 = g->addOp<ReluObj>(a, nullptr)->getOutput();
+        auto r2 = g->addOp<ReluObj>(a, nullptr)->getOutput();
+        g->addOp<AddObj>(r1, r2, nullptr);
+        g->optimize();
+        const auto &cse = statsOf(g, "cse");
+        EXPECT_EQ(cse.rewrites, 1u);
+        EXPECT_EQ(cse.opsBefore, 3u);
+        EXPECT_EQ(cse.opsAfter, 2u);
+        const auto &dce = statsOf(g, "dce");
+        EXPECT_EQ(dce.opsBefore, 2u);
+        EXPECT_EQ(dce.opsAfter, 2u);
+
+        Graph f = make_ref<GraphObj>(runtime);
+        Tensor w = f->addTensor({2, 3}, DataType::Float32);
+        w->setConstant();
+        w->setData(IncrementalGenerator());
+        Tensor x = f->addTensor({2, 3}, DataType::Float32);
+        auto rw = f->addOp<ReluObj>(w, nullptr)->getOutput();
+        f->addOp<AddObj>(x, rw, nullptr);
+        f->optimize();
+        const auto &fold = statsOf(f, "fold-constants");
+        EXPECT_EQ(fold.rewrites, 1u);
+        EXPECT_EQ(fold.opsBefore, 2u);
+        EXPECT_EQ(fold.opsAfter, 1u);
+
+        // Every pass starts from the ops the previous one left.
+        for (const auto &graph : {g, f})
+        {
+            const auto &stats = graph->getPassStats();
+            for (size_t i = 1; i < stats.size(); ++i)
+                EXPECT_EQ(stats[i].opsBefore, stats[i - 1].opsAfter);
+            EXPECT_EQ(stats.back().opsAfter, graph->getOperators().size());
+        }
+    }
+
+} // namespace infini
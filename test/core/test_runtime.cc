@@ -0,0 +1,179 @@
+#include "core/graph.h"
+#include "core/kernel.h"
+#include "core/runtime.h"
+#include "core/thread_pool.h"
+#include "operators/concat.h"
+#include "operators/element_wise.h"
+#include "operators/matmul.h"
+#include "operators/transpose.h"
+#include "operators/unary.h"
+
+#include "test.h"
+
+#include <atomic>
+
+namespace infini
+{
+    // Several independent branches with memory reuse, in-place ops and a
+    // zero-copy Concat joining them.
+    static Tensor buildBranches(const Graph &g, const Tensor &x, int branches)
+    {
+        TensorVec outs;
+        for (int b = 0; b < branches; ++b)
+        {
+            auto t = g->addOp<ReluObj>(x, nullptr)->getOutput();
+            t = g->addOp<TransposeObj>(t, nullptr, Shape{1, 0})->getOutput();
+            t = g->addOp<MatmulObj>(t, x, nullptr)->getOutput();
+            auto c = g->addOp<ClipObj>(t, nullptr, std::nullopt,
+                                       float(b + 1))
+                         ->getOutput();
+            t = g->addOp<AddObj>(t, c, nullptr)->getOutput();
+            outs.emplace_back(g->addOp<ReluObj>(t, nullptr)->getOutput());
+        }
+        return g->addOp<ConcatObj>(outs, nullptr, 0)->getOutput();
+    }
+
+    static vector<float> runBranches(size_t interOp, size_t intraOp,
+                                     int size, int branches)
+    {
+        auto runtime = NativeCpuRuntimeObj::getInstance();
+        runtime->setNumThreads(interOp, intraOp);
+        Graph g = make_ref<GraphObj>(runtime);
+        auto x = g->addTensor({size, size}, DataType::Float32);
+        auto y = buildBranches(g, x, branches);
+        g->dataMalloc();
+        x->setData(IncrementalGenerator());
+        runtime->run(g);
+        runtime->setNumThreads(1, 0);
+        auto ptr = y->getRawDataPtr<float *>();
+        return vector<float>(ptr, ptr + y->size());
+    }
+
+    TEST(Runtime, InterOpParallelMatchesSerial)
+    {
+        auto expected = runBranches(1, 1, 32, 8);
+        for (int k = 0; k < 10; ++k)
+            EXPECT_EQ(runBranches(4, 2, 32, 8), expected);
+    }
+
+    TEST(Runtime, IntraOpParallelMatchesSerial)
+    {
+        // Large enough for every kernel to split its loops.
+        auto expected = runBranches(1, 1, 256, 2);
+        EXPECT_EQ(runBranches(1, 4, 256, 2), expected);
+        EXPECT_EQ(runBranches(2, 3, 256, 2), expected);
+    }
+
+    TEST(Runtime, DependenciesOrderInplaceWrites)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        auto i = g->addTensor({4}, DataType::Float32);
+        auto r = g->addOp<ReluObj>(i, nullptr)->getOutput();
+        auto reader = g->addOp<ReluObj>(r, nullptr);
+        auto writer = g->addOp<ReluObj>(r, nullptr);
+        g->dataMalloc();
+        ASSERT_EQ(writer->getInplaceInput(), 0);
+        // reader and writer are independent data-wise, but writer overwrites
+        // r in place so it must wait for reader.
+        const auto &ops = g->getOperators();
+        ASSERT_EQ(ops, (OpVec{r->getSource(), reader, writer}));
+        const auto &deps = g->getDependencies();
+        EXPECT_EQ(deps.numPredecessors, (vector<size_t>{0, 1, 2}));
+        EXPECT_EQ(deps.successors[deps.successorOffsets[1]], 2u);
+    }
+
+    TEST(Runtime, ExecutionPlanIsCached)
+    {
+        Runtime runtime = NativeCpuRuntimeObj::getInstance();
+        Graph g = make_ref<GraphObj>(runtime);
+        auto x = g->addTensor({2, 3}, DataType::Float32);
+        auto t = g->addOp<TransposeObj>(x, nullptr, Shape{1, 0})->getOutput();
+        auto y = g->addOp<ReluObj>(t, nullptr)->getOutput();
+        g->dataMalloc();
+        EXPECT_TRUE(g->getPlan().steps.empty());
+
+        x->setData(IncrementalGenerator());
+        runtime->run(g);
+        EXPECT_TRUE(y->equalData(vector<float>{0, 3, 1, 4, 2, 5}));
+        const auto &plan = g->getPlan();
+        EXPECT_EQ(plan.runtime, runtime.get());
+        ASSERT_EQ(plan.steps.size(), 2u);
+        auto first = plan.steps.data();
+
+        // New input data is read through the pointers bound at compile time.
+        x->setData([](void *ptr, size_t size, DataType)
+                   {
+                       for (size_t i = 0; i < size; ++i)
+                           static_cast<float *>(ptr)[i] = 3.f - i;
+                   });
+        runtime->run(g);
+        EXPECT_EQ(g->getPlan().steps.data(), first);
+        EXPECT_TRUE(y->equalData(vector<float>{3, 0, 2, 0, 1, 0}));
+
+        g->addOp<ReluObj>(y, nullptr);
+        EXPECT_TRUE(g->getPlan().steps.empty());
+    }
+
+    TEST(Runtime, ThreadPool)
+    {
+        ThreadPool pool(4);
+        TaskGroup group(pool);
+        std::atomic<int> count{0};
+        for (int k = 0; k < 100; ++k)
+            group.spawn([&]
+                        {
+                            ++count;
+                            group.spawn([&] { ++count; });
+                        });
+        group.wait();
+        EXPECT_EQ(count, 200);
+
+        group.spawn([] { IT_ASSERT(false); });
+        EXPECT_THROW(group.wait(), Exception);
+        group.spawn([&] { ++count; });
+        group.wait();
+        EXPECT_EQ(count, 201);
+    }
+
+    TEST(Runtime, ParallelFor)
+    {
+        ThreadPool pool(4);
+        // Nested loops share the pool: every task helps while waiting.
+        vector<std::atomic<int>> hits(1000);
+        pool.parallelFor(10, 1, 4, [&](size_t i0, size_t i1)
+                         {
+                             for (size_t i = i0; i < i1; ++i)
+                                 pool.parallelFor(
+                                     100, 7, 4, [&](size_t j0, size_t j1)
+                                     {
+                                         for (size_t j = j0; j < j1; ++j)
+                                             ++hits[i * 100 + j];
+                                     });
+                         });
+        for (auto &h : hits)
+            EXPECT_EQ(h, 1);
+
+        // Chunks are at least grain long and at most maxChunks are made.
+        std::mutex mutex;
+        vector<pair<size_t, size_t>> ranges;
+        pool.parallelFor(100, 30, 8, [&](size_t begin, size_t end)
+                         {
+                             std::lock_guard<std::mutex> lock(mutex);
+                             ranges.emplace_back(begin, end);
+                         });
+        std::sort(ranges.begin(), ranges.end());
+        EXPECT_EQ(ranges, (vector<pair<size_t, size_t>>{
+                              {0, 33}, {33, 66}, {66, 100}}));
+        ranges.clear();
+        pool.parallelFor(100, 10, 2, [&](size_t begin, size_t end)
+                         {
+                             std::lock_guard<std::mutex> lock(mutex);
+                             ranges.emplace_back(begin, end);
+                         });
+        EXPECT_EQ(ranges.size(), 2u);
+        EXPECT_THROW(pool.parallelFor(100, 1, 4, [](size_t begin, size_t)
+                                      { IT_ASSERT(begin != 50); }),
+                     Exception);
+    }
+} // namespace infini
@@ -0,0 +1,91 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "operators/unary.h"
+
+#include "test.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace infini {
+
+template <typename Src, typename Dst>
+void testCastNativeCpu(CastType castType, DataType srcType,
+                       const vector<Src> &input, const vector<Dst> &expected) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+
+    auto t = g->addTensor({(int)input.size()}, srcType);
+    auto op = g->addOp<CastObj>(t, nullptr, castType);
+    g->dataMalloc();
+    t->setData([&](void *ptr, size_t size, DataType) {
+        std::memcpy(ptr, input.data(), size * sizeof(Src));
+    });
+
+    runtime->run(g);
+    auto out = op->getOutput()->getRawDataPtr<Dst *>();
+    EXPECT_EQ(vector<Dst>(out, out + expected.size()), expected);
+}
+
+TEST(Cast, NativeCpuFloat16) {
+    // 11 elements: one 8-wide vector plus a scalar tail.
+    vector<float> input{1.f,      -2.f,     0.5f,   65504.f,
+                        70000.f,  65519.f,  1e-8f,  5.9604644775390625e-8f,
+                        1.00048828125f,     1.0009765625f, -INFINITY};
+    vector<uint16_t> expected{0x3C00, 0xC000, 0x3800, 0x7BFF, 0x7C00, 0x7BFF,
+                              0x0000, 0x0001, 0x3C00, 0x3C01, 0xFC00};
+    testCastNativeCpu(CastType::Float2Float16, DataType::Float32, input,
+                      expected);
+
+    vector<float> back{1.f,      -2.f, 0.5f, 65504.f,
+                       INFINITY, 65504.f, 0.f, 5.9604644775390625e-8f,
+                       1.f,      1.0009765625f, -INFINITY};
+    testCastNativeCpu(CastType::Float162Float, DataType::Float16, expected,
+                      back);
+}
+
+TEST(Cast, NativeCpuBFloat16) {
+    // 1 + 2^-8 is a tie rounded to even, 1 + 3 * 2^-8 rounds up.
+    vector<float> input{1.f, -3.5f, 1.00390625f, 1.01171875f, 1e30f};
+    vector<uint16_t> expected{0x3F80, 0xC060, 0x3F80, 0x3F82, 0x714A};
+    testCastNativeCpu(CastType::Float2BFloat16, DataType::Float32, input,
+                      expected);
+    testCastNativeCpu(CastType::BFloat162Float, DataType::BFloat16,
+                      vector<uint16_t>{0x3F80, 0xC060, 0x3F82},
+                      vector<float>{1.f, -3.5f, 1.015625f});
+}
+
+TEST(Cast, NativeCpuIntegers) {
+    testCastNativeCpu(CastType::Float2Int32, DataType::Float32,
+                      vector<float>{1.9f, -1.9f, 0.f, 1e6f},
+                      vector<int32_t>{1, -1, 0, 1000000});
+    testCastNativeCpu(CastType::Int82Int32, DataType::Int8,
+                      vector<int8_t>{-128, -1, 0, 127},
+                      vector<int32_t>{-128, -1, 0, 127});
+    testCastNativeCpu(CastType::Uint82Float, DataType::UInt8,
+                      vector<uint8_t>{0, 128, 255},
+                      vector<float>{0.f, 128.f, 255.f});
+    testCastNativeCpu(CastType::Int642Int32, DataType::Int64,
+                      vector<int64_t>{-5, 1ll << 32, (1ll << 32) + 7},
+                      vector<int32_t>{-5, 0, 7});
+    testCastNativeCpu(CastType::Int322Int8, DataType::Int32,
+                      vector<int32_t>{-1, 255, 256 + 3},
+                      vector<int8_t>{-1, -1, 3});
+    testCastNativeCpu(CastType::Uint322Int64, DataType::UInt32,
+                      vector<uint32_t>{0, 0xFFFFFFFFu},
+                      vector<int64_t>{0, 0xFFFFFFFFll});
+}
+
+TEST(Cast, NativeCpuLarge) {
+    // Large enough to be split into several blocks.
+    const size_t n = (1 << 16) + 5;
+    vector<int32_t> input(n);
+    vector<float> expected(n);
+    for (size_t i = 0; i < n; ++i) {
+        input[i] = (int32_t)i - 1000;
+        expected[i] = (float)input[i];
+    }
+    testCastNativeCpu(CastType::Int322Float, DataType::Int32, input, expected);
+}
+
+} // namespace infini
@@ -1,6 +1,7 @@
 #include "core/graph.h"
 #include "core/runtime.h"
 #include "operators/concat.h"
+#include "operators/unary.h"
 
 #include "test.h"
 
@@ -25,4 +26,32 @@ TEST(Concat, NativeCpu) {
                       6, 7, 8, 1, 1, 1, 9, 10, 11, 1, 1, 1}));
 }
 
+TEST(Concat, NativeCpuZeroCopy) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+
+    auto t1 = g->addTensor({1, 2, 3}, DataType::Float32);
+    auto t2 = g->addTensor({1, 1, 3}, DataType::Float32);
+    auto r1 = g->addOp<ReluObj>(t1, nullptr)->getOutput();
+    auto r2 = g->addOp<ReluObj>(t2, nullptr)->getOutput();
+    auto r3 = g->addOp<ReluObj>(r2, nullptr)->getOutput();
+    auto inner = g->addOp<ConcatObj>(TensorVec{r1, r2}, nullptr, 1);
+    auto op = g->addOp<ConcatObj>(TensorVec{inner->getOutput(), r3}, nullptr,
+                                  -2);
+    g->dataMalloc();
+
+    // Relu outputs, including the nested Concat, live inside the output.
+    auto out = op->getOutput()->getRawDataPtr<float *>();
+    EXPECT_EQ(r1->getRawDataPtr<float *>(), out);
+    EXPECT_EQ(r2->getRawDataPtr<float *>(), out + 6);
+    EXPECT_EQ(r3->getRawDataPtr<float *>(), out + 9);
+    EXPECT_EQ(inner->getOutput()->getRawDataPtr<float *>(), out);
+
+    t1->setData(IncrementalGenerator());
+    t2->setData(OneGenerator());
+    runtime->run(g);
+    EXPECT_TRUE(op->getOutput()->equalData(
+        vector<float>{0, 1, 2, 3, 4, 5, 1, 1, 1, 1, 1, 1}));
+}
+
 } // namespace infini
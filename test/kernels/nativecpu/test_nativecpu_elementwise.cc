@@ -1,6 +1,7 @@
 #include "core/graph.h"
 #include "core/runtime.h"
 #include "operators/element_wise.h"
+#include "utils/operator_utils.h"
 
 #include "test.h"
 
@@ -41,4 +42,51 @@ TEST(ElementWise, NativeCpu) {
         Shape{2, 1, 1}, ExpectOutput{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11});
 }
 
+// Compares Sub against index-by-index broadcasting on shapes large enough to
+// be split across blocks and threads.
+static void testBroadcastPattern(const Shape &shape1, const Shape &shape2) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto t1 = g->addTensor(shape1, DataType::Float32);
+    auto t2 = g->addTensor(shape2, DataType::Float32);
+    auto op = g->addOp<SubObj>(t1, t2, nullptr);
+    g->dataMalloc();
+    t1->setData(IncrementalGenerator());
+    t2->setData(IncrementalGenerator());
+    runtime->run(g);
+
+    auto out = op->getOutput();
+    auto shapeC = out->getDims();
+    auto rank = shapeC.size();
+    Shape a(rank, 1), b(rank, 1);
+    std::copy(shape1.begin(), shape1.end(), a.begin() + (rank - shape1.size()));
+    std::copy(shape2.begin(), shape2.end(), b.begin() + (rank - shape2.size()));
+    auto getStride = [&](const Shape &shape) {
+        Shape stride(rank);
+        for (int i = rank - 1, p = 1; i >= 0; p *= shape[i--])
+            stride[i] = p;
+        return stride;
+    };
+    auto strideA = getStride(a), strideB = getStride(b);
+    vector<float> expected(out->size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        auto index = locate_index(i, shapeC);
+        expected[i] = float(delocate_index(index, a, strideA)) -
+                      float(delocate_index(index, b, strideB));
+    }
+    EXPECT_TRUE(out->equalData(expected));
+}
+
+TEST(ElementWise, NativeCpuBroadcastPatterns) {
+    testBroadcastPattern(Shape{3, 70, 130}, Shape{3, 70, 130}); // same shape
+    testBroadcastPattern(Shape{3, 70, 130}, Shape{1});          // scalar
+    testBroadcastPattern(Shape{1}, Shape{3, 70, 130});
+    testBroadcastPattern(Shape{3, 70, 130}, Shape{130});       // row
+    testBroadcastPattern(Shape{3, 70, 130}, Shape{3, 70, 1});  // column
+    testBroadcastPattern(Shape{3, 70, 1}, Shape{1, 130});      // outer
+    testBroadcastPattern(Shape{2, 1, 5, 1, 7}, Shape{3, 1, 11, 7});
+    testBroadcastPattern(Shape{5000, 2}, Shape{5000, 1});
+    testBroadcastPattern(Shape{2, 9000}, Shape{1, 9000});
+}
+
 } // namespace infini
@@ -0,0 +1,70 @@
+#include "core/graph.h"
+#include "core/runtime.h"
+#include "operators/element_wise.h"
+#include "operators/fused_element_wise.h"
+#include "operators/unary.h"
+
+#include "test.h"
+
+namespace infini {
+
+// Evaluates Mul(Clip(Relu(Sub(a, b)), 2, 40), Div(c, d)) unfused and as one
+// FusedElementWise op over broadcast inputs, and compares the results.
+static void testFusedMatchesUnfused(DataType dtype, const Shape &shapeA,
+                                    const Shape &shapeB, const Shape &shapeC,
+                                    const Shape &shapeD) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    auto build = [&](const Graph &g) {
+        return TensorVec{g->addTensor(shapeA, dtype),
+                         g->addTensor(shapeB, dtype),
+                         g->addTensor(shapeC, dtype),
+                         g->addTensor(shapeD, dtype)};
+    };
+    auto fill = [](const TensorVec &in) {
+        in[0]->setData(IncrementalGenerator());
+        in[1]->setData(ValGenerator<3>());
+        in[2]->setData(IncrementalGenerator());
+        in[3]->setData(ValGenerator<2>());
+    };
+
+    Graph g = make_ref<GraphObj>(runtime);
+    auto in = build(g);
+    auto x = g->addOp<SubObj>(in[0], in[1], nullptr)->getOutput();
+    x = g->addOp<ReluObj>(x, nullptr)->getOutput();
+    x = g->addOp<ClipObj>(x, nullptr, 2.f, 40.f)->getOutput();
+    auto y = g->addOp<DivObj>(in[2], in[3], nullptr)->getOutput();
+    auto expected = g->addOp<MulObj>(x, y, nullptr)->getOutput();
+    g->dataMalloc();
+    fill(in);
+    runtime->run(g);
+
+    Graph f = make_ref<GraphObj>(runtime);
+    auto fin = build(f);
+    auto out = f->addTensor(expected->getDims(), dtype);
+    vector<FusedStep> program{
+        {FusedStep::Input, 0}, {FusedStep::Input, 1},
+        {FusedStep::Sub},      {FusedStep::Relu},
+        {FusedStep::Clip, 0, 2.f, 40.f},
+        {FusedStep::Input, 2}, {FusedStep::Input, 3},
+        {FusedStep::Div},      {FusedStep::Mul}};
+    auto op = f->addOpWithOutputs<FusedElementWiseObj>(fin, out, program);
+    EXPECT_EQ(op->getStackDepth(), 3u);
+    f->dataMalloc();
+    fill(fin);
+    runtime->run(f);
+    EXPECT_TRUE(out->equalData(expected));
+}
+
+TEST(FusedElementWise, NativeCpu) {
+    for (auto dtype : {DataType::Float32, DataType::UInt32}) {
+        testFusedMatchesUnfused(dtype, {2, 3, 4}, {2, 3, 4}, {2, 3, 4},
+                                {2, 3, 4});
+        testFusedMatchesUnfused(dtype, {2, 3, 4}, {4}, {2, 1, 4}, {1});
+        testFusedMatchesUnfused(dtype, {4}, {3, 1}, {1}, {1});
+        // Rows split across blocks and threads.
+        testFusedMatchesUnfused(dtype, {8, 3000}, {3000}, {8, 1}, {1});
+        testFusedMatchesUnfused(dtype, {1}, {1}, {1}, {1});
+    }
+}
+
+} // namespace infini
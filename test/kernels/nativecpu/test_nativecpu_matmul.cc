@@ -0,0 +1,208 @@
+#include "core/graph.h"
+#include "core/kernel.h"
+#include "core/runtime.h"
+#include "kernels/cpu/gemm.h"
+#include "operators/element_wise.h"
+#include "operators/matmul.h"
+#include "operators/unary.h"
+
+#include "test.h"
+
+namespace infini {
+
+// Small integers scaled by 1/4 keep every partial sum exact in float, so the
+// blocked kernel can be compared bit-for-bit with the reference loop.
+static void fillExact(void *data, size_t size, DataType dtype) {
+    auto ptr = reinterpret_cast<float *>(data);
+    for (size_t i = 0; i < size; ++i)
+        ptr[i] = static_cast<float>(static_cast<int>((i * 7 + 3) % 11) - 5) /
+                 4.f;
+}
+
+static void testMatmulNativeCpu(const Shape &batchA, const Shape &batchB,
+                                int M, int N, int K, bool transA,
+                                bool transB) {
+    Shape shapeA = batchA, shapeB = batchB;
+    shapeA.insert(shapeA.end(), {transA ? K : M, transA ? M : K});
+    shapeB.insert(shapeB.end(), {transB ? N : K, transB ? K : N});
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto a = g->addTensor(shapeA, DataType::Float32);
+    auto b = g->addTensor(shapeB, DataType::Float32);
+    auto op = g->addOp<MatmulObj>(a, b, nullptr, transA, transB);
+    g->dataMalloc();
+    a->setData(fillExact);
+    b->setData(fillExact);
+    runtime->run(g);
+
+    // Reference: plain triple loop with explicit broadcast of batch dims.
+    auto c = op->getOutput();
+    auto shapeC = c->getDims();
+    size_t rank = shapeC.size();
+    EXPECT_EQ(op->getM(), M);
+    EXPECT_EQ(op->getN(), N);
+    EXPECT_EQ(op->getK(), K);
+    auto pa = a->getRawDataPtr<float *>(), pb = b->getRawDataPtr<float *>();
+    vector<float> expected(c->size());
+    size_t batch = c->size() / (M * N);
+    auto batchOffset = [&](const Shape &shape, size_t idx) {
+        size_t offset = 0, step = shape[shape.size() - 1] *
+                                  shape[shape.size() - 2];
+        for (size_t i = 0; i + 2 < shape.size(); ++i) {
+            size_t d = shape.size() - 3 - i, od = rank - 3 - i;
+            size_t stride = 1;
+            for (size_t j = od + 1; j + 2 < rank; ++j)
+                stride *= shapeC[j];
+            size_t pos = idx / stride % shapeC[od];
+            offset += (shape[d] == 1 ? 0 : pos) * step;
+            step *= shape[d];
+        }
+        return offset;
+    };
+    for (size_t bi = 0; bi < batch; ++bi) {
+        auto ma = pa + batchOffset(shapeA, bi), mb = pb + batchOffset(shapeB, bi);
+        for (int i = 0; i < M; ++i)
+            for (int j = 0; j < N; ++j) {
+                float acc = 0;
+                for (int p = 0; p < K; ++p)
+                    acc += (transA ? ma[p * M + i] : ma[i * K + p]) *
+                           (transB ? mb[j * K + p] : mb[p * N + j]);
+                expected[bi * M * N + i * N + j] = acc;
+            }
+    }
+    EXPECT_TRUE(c->equalData(expected));
+}
+
+TEST(Matmul, NativeCpu) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto a = g->addTensor({1, 2, 3}, DataType::Float32);
+    auto b = g->addTensor({1, 3, 2}, DataType::Float32);
+    auto op = g->addOp<MatmulObj>(a, b, nullptr);
+    g->dataMalloc();
+    a->setData(IncrementalGenerator());
+    b->setData(IncrementalGenerator());
+    runtime->run(g);
+    EXPECT_TRUE(op->getOutput()->equalData(vector<float>{10, 13, 28, 40}));
+}
+
+TEST(Matmul, NativeCpuTranspose) {
+    for (bool transA : {false, true})
+        for (bool transB : {false, true}) {
+            testMatmulNativeCpu(Shape{2}, Shape{2}, 5, 3, 7, transA, transB);
+            // Crosses every register tile and cache block boundary.
+            testMatmulNativeCpu(Shape{1}, Shape{1}, 37, 45, 300, transA,
+                                transB);
+        }
+}
+
+TEST(Matmul, NativeCpuBroadcast) {
+    testMatmulNativeCpu(Shape{2, 3}, Shape{1, 3}, 5, 6, 4, false, false);
+    testMatmulNativeCpu(Shape{2, 1}, Shape{3}, 5, 6, 4, false, true);
+    testMatmulNativeCpu(Shape{}, Shape{2, 3}, 6, 5, 4, true, false);
+    // Attention-like batches, with and without a B shared across batches.
+    testMatmulNativeCpu(Shape{2, 4}, Shape{2, 4}, 33, 70, 50, false, true);
+    testMatmulNativeCpu(Shape{2, 4}, Shape{1, 1}, 33, 70, 50, false, true);
+    // A shared across batches, over several M and K blocks.
+    for (bool transA : {false, true})
+        testMatmulNativeCpu(Shape{1, 1}, Shape{2, 3}, 150, 40, 300, transA,
+                            false);
+}
+
+// Runs MatMul -> Add(bias) -> Relu -> Clip unfused, then with the Add,
+// Relu and Clip folded into the MatMul epilogue, and compares the outputs.
+static void testMatmulEpilogue(DataType dtype, const Shape &batch, int M,
+                               int N, int K, const Shape &biasShape) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    auto build = [&](const Graph &g) {
+        Shape shapeA = batch, shapeB = batch;
+        shapeA.insert(shapeA.end(), {M, K});
+        shapeB.insert(shapeB.end(), {K, N});
+        auto a = g->addTensor(shapeA, dtype), b = g->addTensor(shapeB, dtype),
+             bias = g->addTensor(biasShape, dtype);
+        auto y = g->addOp<MatmulObj>(a, b, nullptr)->getOutput();
+        y = g->addOp<AddObj>(bias, y, nullptr)->getOutput();
+        y = g->addOp<ReluObj>(y, nullptr)->getOutput();
+        auto out = g->addOp<ClipObj>(y, nullptr, -1.f, 3.f)->getOutput();
+        g->dataMalloc();
+        for (auto &t : {a, b, bias}) {
+            if (dtype == DataType::Float32)
+                t->setData(fillExact);
+            else
+                t->setData(IncrementalGenerator());
+        }
+        return out;
+    };
+    Graph g = make_ref<GraphObj>(runtime);
+    auto expected = build(g);
+    runtime->run(g);
+
+    Graph f = make_ref<GraphObj>(runtime);
+    auto out = build(f);
+    f->optimize();
+    ASSERT_EQ(f->getOperators().size(), 1u);
+    auto mm = as<MatmulObj>(f->getOperators()[0]);
+    EXPECT_EQ(mm->getBias()->getDims(), biasShape);
+    EXPECT_EQ(mm->getClipMin(), 0.f);
+    EXPECT_EQ(mm->getClipMax(), 3.f);
+    EXPECT_EQ(mm->getOutput(), out);
+    runtime->run(f);
+    EXPECT_TRUE(out->equalData(expected));
+}
+
+TEST(Matmul, NativeCpuEpilogue) {
+    for (auto dtype : {DataType::Float32, DataType::UInt32}) {
+        testMatmulEpilogue(dtype, {1}, 5, 6, 4, {6});
+        testMatmulEpilogue(dtype, {2, 3}, 5, 6, 4, {5, 1});
+        testMatmulEpilogue(dtype, {1}, 5, 6, 4, {1, 5, 6});
+        testMatmulEpilogue(dtype, {2}, 5, 6, 4, {1});
+    }
+    // Full and edge register tiles, several K blocks and batches.
+    testMatmulEpilogue(DataType::Float32, {1}, 50, 70, 200, {70});
+    testMatmulEpilogue(DataType::Float32, {3}, 50, 70, 200, {50, 70});
+    testMatmulEpilogue(DataType::Float32, {4, 2}, 33, 40, 20, {33, 1});
+}
+
+// A constant B is packed once at compile time and gives the same result.
+static void testMatmulPackedB(const Shape &batchA, const Shape &batchB, int M,
+                              int N, int K, bool transB) {
+    Shape shapeA = batchA, shapeB = batchB;
+    shapeA.insert(shapeA.end(), {M, K});
+    shapeB.insert(shapeB.end(), {transB ? N : K, transB ? K : N});
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    auto build = [&](const Graph &g, bool constant) {
+        auto a = g->addTensor(shapeA, DataType::Float32),
+             b = g->addTensor(shapeB, DataType::Float32);
+        if (constant) {
+            b->setConstant();
+            b->setData(fillExact);
+        }
+        auto c = g->addOp<MatmulObj>(a, b, nullptr, false, transB)
+                     ->getOutput();
+        g->dataMalloc();
+        a->setData(fillExact);
+        if (!constant)
+            b->setData(fillExact);
+        return TensorVec{b, c};
+    };
+    Graph g = make_ref<GraphObj>(runtime);
+    auto expected = build(g, false);
+    runtime->run(g);
+    Graph f = make_ref<GraphObj>(runtime);
+    auto packed = build(f, true);
+    runtime->run(f);
+    EXPECT_TRUE(packed[1]->equalData(expected[1]));
+    EXPECT_FALSE(expected[0]->getPackedData(
+        string("sgemm-") + cpu::sgemmKernelName() + (transB ? "-T" : "-N")));
+    EXPECT_TRUE(packed[0]->getPackedData(
+        string("sgemm-") + cpu::sgemmKernelName() + (transB ? "-T" : "-N")));
+}
+
+TEST(Matmul, NativeCpuPackedB) {
+    testMatmulPackedB(Shape{1}, Shape{}, 5, 6, 4, false);
+    testMatmulPackedB(Shape{1}, Shape{}, 50, 70, 200, true);
+    testMatmulPackedB(Shape{3}, Shape{1}, 33, 40, 20, false);
+    testMatmulPackedB(Shape{2, 3}, Shape{3}, 13, 40, 20, true);
+}
+
+} // namespace infini
@@ -24,4 +24,44 @@ TEST(Transpose, NativeCpu) {
                                                           8, 9, 10, 11, 20, 21, 22, 23}));
 }
 
+static void testTransposePattern(const Shape &shape, const Shape &permute) {
+    Runtime runtime = NativeCpuRuntimeObj::getInstance();
+    Graph g = make_ref<GraphObj>(runtime);
+    auto input = g->addTensor(shape, DataType::Float32);
+    auto op = g->addOp<TransposeObj>(input, nullptr, permute);
+    g->dataMalloc();
+    input->setData(IncrementalGenerator());
+    runtime->run(g);
+
+    // Output element at position pos holds the input index of position
+    // pos permuted back.
+    auto outDim = op->getOutput()->getDims();
+    vector<float> expected(input->size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        size_t rest = i;
+        Shape pos(outDim.size());
+        for (size_t j = outDim.size(); j-- > 0; rest /= outDim[j])
+            pos[j] = rest % outDim[j];
+        Shape inPos(shape.size());
+        for (size_t j = 0; j < permute.size(); ++j)
+            inPos[permute[j]] = pos[j];
+        size_t inIdx = 0;
+        for (size_t d = 0; d < shape.size(); ++d)
+            inIdx = inIdx * shape[d] + inPos[d];
+        expected[i] = inIdx;
+    }
+    EXPECT_TRUE(op->getOutput()->equalData(expected));
+}
+
+TEST(Transpose, NativeCpuPatterns) {
+    testTransposePattern({64, 64}, {1, 0});
+    testTransposePattern({3, 37, 41}, {0, 2, 1});
+    testTransposePattern({5, 70, 90}, {1, 0, 2});
+    testTransposePattern({2, 3, 4, 5}, {3, 2, 1, 0});
+    testTransposePattern({1, 9, 1, 17}, {3, 1, 2, 0});
+    testTransposePattern({2, 3, 4, 5, 6}, {0, 3, 4, 1, 2});
+    testTransposePattern({4, 50, 3, 70}, {2, 3, 0, 1});
+    testTransposePattern({2, 3, 4}, {0, 1, 2});
+}
+
 } // namespace infini